@@ -92,6 +92,7 @@ typedef struct _capture_file {
   wtap        *wth;             /* Wiretap session */
   dfilter_t   *rfcode;          /* Compiled read (display) filter program */
   gchar       *dfilter;         /* Display filter string */
+  gboolean     dfilter_applied; /* TRUE if every frame's passed_dfilter flag reflects dfilter */
   gboolean     redissecting;    /* TRUE if currently redissecting (cf_redissect_packets) */
   /* search */
   gchar       *sfilter;         /* Filter, hex value, or string being searched */
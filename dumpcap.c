@@ -142,9 +142,9 @@ FILE *debug_log;   /* for logging debug messages to  */
                    /*  is defined                    */
 #endif
 
-static GAsyncQueue *pcap_queue;
-static gint64 pcap_queue_bytes;
-static gint64 pcap_queue_packets;
+/* Number of bytes and packets sitting in the capture rings (see pcap_ring) */
+static volatile gint pcap_queue_bytes;
+static volatile gint pcap_queue_packets;
 static gint64 pcap_queue_byte_limit = 1024 * 1024;
 static gint64 pcap_queue_packet_limit = 1000;
 
@@ -224,6 +224,39 @@ typedef enum {
     INITFILTER_OTHER_ERROR
 } initfilter_status_t;
 
+/*
+ * When capturing with threads, each capture thread hands its packets to
+ * the writer thread through a ring buffer of its own.  Only the capture
+ * thread advances "tail" and only the writer thread advances "head", so
+ * no lock is needed, and the packet is copied straight into space that
+ * was allocated when the capture started.
+ *
+ * "head" and "tail" are free-running byte counts; the offset into "buf"
+ * is the count modulo "size", which is a power of 2.  Records are
+ * PCAP_RING_ALIGN-aligned and never wrap past the end of "buf"; if one
+ * doesn't fit before the end, a record with a length of 0 is put there
+ * and the record goes at the start of "buf".
+ */
+typedef struct _pcap_ring {
+    guchar        *buf;
+    guint          size;
+    volatile gint  head;                  /* advanced by the writer thread */
+    volatile gint  tail;                  /* advanced by the capture thread */
+} pcap_ring;
+
+typedef struct _pcap_ring_rec {
+    guint32            rec_len;           /* length of this record, 0 = skip to start */
+    struct pcap_pkthdr phdr;
+    /* the packet data follows */
+} pcap_ring_rec;
+
+#define PCAP_RING_ALIGN 8
+#define PCAP_RING_REC_LEN(caplen) \
+    (((guint)sizeof(pcap_ring_rec) + (guint)(caplen) + (PCAP_RING_ALIGN - 1)) & ~(PCAP_RING_ALIGN - 1))
+
+/* Maximum number of packets the writer thread takes from one ring at once */
+#define PCAP_RING_BATCH 64
+
 typedef struct _pcap_options {
     guint32        received;
     guint32        dropped;
@@ -264,6 +297,7 @@ typedef struct _pcap_options {
     GMutex *cap_pipe_read_mtx;
     GAsyncQueue *cap_pipe_pending_q, *cap_pipe_done_q;
 #endif
+    pcap_ring      ring;                  /* packets queued for the writer thread */
 } pcap_options;
 
 typedef struct _loop_data {
@@ -284,12 +318,6 @@ typedef struct _loop_data {
     guint32        autostop_files;
 } loop_data;
 
-typedef struct _pcap_queue_element {
-    pcap_options       *pcap_opts;
-    struct pcap_pkthdr phdr;
-    u_char             *pd;
-} pcap_queue_element;
-
 /*
  * Standard secondary message for unexpected errors.
  */
@@ -339,6 +367,11 @@ static gboolean need_timeout_workaround;
 
 #define WRITER_THREAD_TIMEOUT 100000 /* usecs */
 
+/* The writer thread sleeps on this while all the capture rings are empty */
+static GMutex *pcap_queue_mtx;
+static GCond *pcap_queue_cond;
+static volatile gint pcap_queue_writer_waiting;
+
 static void
 console_log_handler(const char *log_domain, GLogLevelFlags log_level,
                     const char *message, gpointer user_data _U_);
@@ -2577,6 +2610,7 @@ capture_loop_open_input(capture_options *capture_opts, loop_data *ld,
         pcap_opts->cap_pipe_bytes_read = 0;
         pcap_opts->cap_pipe_state = 0;
         pcap_opts->cap_pipe_err = PIPOK;
+        memset(&pcap_opts->ring, 0, sizeof(pcap_ring));
 #ifdef _WIN32
 #if GLIB_CHECK_VERSION(2,31,0)
         pcap_opts->cap_pipe_read_mtx = g_malloc(sizeof(GMutex));
@@ -2864,7 +2898,7 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
                                                    pcap_opts->ts_nsec, &ld->bytes_written, &err);
         }
         if (!successful) {
-            fclose(ld->pdh);
+            libpcap_dump_close(ld->pdh, NULL);
             ld->pdh = NULL;
         }
     }
@@ -3328,7 +3362,7 @@ do_file_switch_or_stop(capture_options *capture_opts,
                                                        pcap_opts->ts_nsec, &global_ld.bytes_written, &global_ld.err);
             }
             if (!successful) {
-                fclose(global_ld.pdh);
+                libpcap_dump_close(global_ld.pdh, NULL);
                 global_ld.pdh = NULL;
                 global_ld.go = FALSE;
                 return FALSE;
@@ -3376,6 +3410,121 @@ pcap_read_handler(void* arg)
     return (NULL);
 }
 
+/*
+ * Allocate a capture ring big enough that the queue limits, rather than
+ * the ring running out of space, decide when packets are dropped.
+ */
+static void
+pcap_ring_init(pcap_ring *ring)
+{
+    gint64 needed;
+
+    /* pcap_queue_bytes is only a gint, as we update it atomically; it can
+       go at most one packet over the limit, so keep that within range. */
+    if (pcap_queue_byte_limit > G_MAXINT - WTAP_MAX_PACKET_SIZE)
+        pcap_queue_byte_limit = G_MAXINT - WTAP_MAX_PACKET_SIZE;
+
+    needed = pcap_queue_byte_limit +
+             pcap_queue_packet_limit * (gint64)(sizeof(pcap_ring_rec) + PCAP_RING_ALIGN) +
+             2 * PCAP_RING_REC_LEN(WTAP_MAX_PACKET_SIZE);
+    /* The size must be a power of 2, as offsets are head/tail & (size - 1) */
+    ring->size = 1;
+    while (ring->size < needed && ring->size < (1U << 30))
+        ring->size <<= 1;
+    ring->buf = (guchar *)g_malloc(ring->size);
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/*
+ * Write out up to PCAP_RING_BATCH packets from the ring of each interface.
+ * Returns the number of packets written.
+ */
+static int
+capture_loop_dequeue_packets(loop_data *ld)
+{
+    pcap_options *pcap_opts;
+    pcap_ring *ring;
+    pcap_ring_rec *rec;
+    guint i, head, tail, offset;
+    gint bytes, packets, inpkts = 0;
+
+    for (i = 0; i < ld->pcaps->len; i++) {
+        pcap_opts = g_array_index(ld->pcaps, pcap_options *, i);
+        ring = &pcap_opts->ring;
+        head = (guint)ring->head;
+        tail = (guint)g_atomic_int_get(&ring->tail);
+        bytes = 0;
+        packets = 0;
+        while (head != tail && packets < PCAP_RING_BATCH) {
+            offset = head & (ring->size - 1);
+            rec = (pcap_ring_rec *)(void *)(ring->buf + offset);
+            if (rec->rec_len == 0) {
+                /* the next record is at the start of the ring */
+                head += ring->size - offset;
+                continue;
+            }
+            g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+                  "Dequeued a packet of length %d captured on interface %d.",
+                  rec->phdr.caplen, pcap_opts->interface_id);
+            capture_loop_write_packet_cb((u_char *)pcap_opts, &rec->phdr,
+                                         (u_char *)(rec + 1));
+            bytes += rec->phdr.caplen;
+            packets++;
+            head += rec->rec_len;
+        }
+        if (head != (guint)ring->head) {
+            /* Hand the space back to the capture thread in one go. */
+            g_atomic_int_set(&ring->head, (gint)head);
+            g_atomic_int_add(&pcap_queue_bytes, -bytes);
+            g_atomic_int_add(&pcap_queue_packets, -packets);
+        }
+        inpkts += packets;
+    }
+    return inpkts;
+}
+
+/*
+ * Wait up to WRITER_THREAD_TIMEOUT for a capture thread to queue a packet.
+ */
+static void
+capture_loop_wait_for_packets(loop_data *ld)
+{
+    pcap_options *pcap_opts;
+    guint i;
+    gboolean empty = TRUE;
+#if GLIB_CHECK_VERSION(2,31,18)
+    gint64 end_time = g_get_monotonic_time() + WRITER_THREAD_TIMEOUT;
+#else
+    GTimeVal end_time;
+
+    g_get_current_time(&end_time);
+    g_time_val_add(&end_time, WRITER_THREAD_TIMEOUT);
+#endif
+
+    g_mutex_lock(pcap_queue_mtx);
+    g_atomic_int_set(&pcap_queue_writer_waiting, 1);
+    /* A packet may have been queued before the capture threads could see
+       that we're waiting; check again so that it doesn't sit there until
+       we time out. */
+    for (i = 0; i < ld->pcaps->len; i++) {
+        pcap_opts = g_array_index(ld->pcaps, pcap_options *, i);
+        if (g_atomic_int_get(&pcap_opts->ring.tail) != pcap_opts->ring.head) {
+            empty = FALSE;
+            break;
+        }
+    }
+    if (empty) {
+#if GLIB_CHECK_VERSION(2,31,18)
+        g_cond_wait_until(pcap_queue_cond, pcap_queue_mtx, end_time);
+#else
+        g_cond_timed_wait(pcap_queue_cond, pcap_queue_mtx, &end_time);
+#endif
+    }
+    g_atomic_int_set(&pcap_queue_writer_waiting, 0);
+    g_mutex_unlock(pcap_queue_mtx);
+}
+
 /* Do the low-level work of a capture.
    Returns TRUE if it succeeds, FALSE otherwise. */
 static gboolean
@@ -3524,11 +3673,21 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     /* WOW, everything is prepared! */
     /* please fasten your seat belts, we will enter now the actual capture loop */
     if (use_threads) {
-        pcap_queue = g_async_queue_new();
         pcap_queue_bytes = 0;
         pcap_queue_packets = 0;
+        pcap_queue_writer_waiting = 0;
+#if GLIB_CHECK_VERSION(2,31,0)
+        pcap_queue_mtx = g_malloc(sizeof(GMutex));
+        g_mutex_init(pcap_queue_mtx);
+        pcap_queue_cond = g_malloc(sizeof(GCond));
+        g_cond_init(pcap_queue_cond);
+#else
+        pcap_queue_mtx = g_mutex_new();
+        pcap_queue_cond = g_cond_new();
+#endif
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+            pcap_ring_init(&pcap_opts->ring);
 #if GLIB_CHECK_VERSION(2,31,0)
             /* XXX - Add an interface name here? */
             pcap_opts->tid = g_thread_new("Capture read", pcap_read_handler, pcap_opts);
@@ -3540,37 +3699,9 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     while (global_ld.go) {
         /* dispatch incoming packets */
         if (use_threads) {
-            pcap_queue_element *queue_element;
-#if GLIB_CHECK_VERSION(2,31,18)
-
-            g_async_queue_lock(pcap_queue);
-            queue_element = g_async_queue_timeout_pop_unlocked(pcap_queue, WRITER_THREAD_TIMEOUT);
-#else
-            GTimeVal write_thread_time;
-
-            g_get_current_time(&write_thread_time);
-            g_time_val_add(&write_thread_time, WRITER_THREAD_TIMEOUT);
-            g_async_queue_lock(pcap_queue);
-            queue_element = g_async_queue_timed_pop_unlocked(pcap_queue, &write_thread_time);
-#endif
-            if (queue_element) {
-                pcap_queue_bytes -= queue_element->phdr.caplen;
-                pcap_queue_packets -= 1;
-            }
-            g_async_queue_unlock(pcap_queue);
-            if (queue_element) {
-                g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-                      "Dequeued a packet of length %d captured on interface %d.",
-                      queue_element->phdr.caplen, queue_element->pcap_opts->interface_id);
-
-                capture_loop_write_packet_cb((u_char *) queue_element->pcap_opts,
-                                             &queue_element->phdr,
-                                             queue_element->pd);
-                g_free(queue_element->pd);
-                g_free(queue_element);
-                inpkts = 1;
-            } else {
-                inpkts = 0;
+            inpkts = capture_loop_dequeue_packets(&global_ld);
+            if (inpkts == 0) {
+                capture_loop_wait_for_packets(&global_ld);
             }
         } else {
             pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, 0);
@@ -3663,8 +3794,6 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Capture loop stopping ...");
     if (use_threads) {
-        pcap_queue_element *queue_element;
-
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
             g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Waiting for thread of interface %u...",
@@ -3673,30 +3802,28 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO, "Thread of interface %u terminated.",
                   pcap_opts->interface_id);
         }
-        while (1) {
-            g_async_queue_lock(pcap_queue);
-            queue_element = g_async_queue_try_pop_unlocked(pcap_queue);
-            if (queue_element) {
-                pcap_queue_bytes -= queue_element->phdr.caplen;
-                pcap_queue_packets -= 1;
-            }
-            g_async_queue_unlock(pcap_queue);
-            if (queue_element == NULL) {
-                break;
-            }
-            g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-                  "Dequeued a packet of length %d captured on interface %d.",
-                  queue_element->phdr.caplen, queue_element->pcap_opts->interface_id);
-            capture_loop_write_packet_cb((u_char *)queue_element->pcap_opts,
-                                         &queue_element->phdr,
-                                         queue_element->pd);
-            g_free(queue_element->pd);
-            g_free(queue_element);
-            global_ld.inpkts_to_sync_pipe += 1;
+        while ((inpkts = capture_loop_dequeue_packets(&global_ld)) > 0) {
+            global_ld.inpkts_to_sync_pipe += inpkts;
             if (capture_opts->output_to_pipe) {
                 libpcap_dump_flush(global_ld.pdh, NULL);
             }
         }
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_opts = g_array_index(global_ld.pcaps, pcap_options *, i);
+            g_free(pcap_opts->ring.buf);
+            memset(&pcap_opts->ring, 0, sizeof(pcap_ring));
+        }
+#if GLIB_CHECK_VERSION(2,31,0)
+        g_cond_clear(pcap_queue_cond);
+        g_free(pcap_queue_cond);
+        g_mutex_clear(pcap_queue_mtx);
+        g_free(pcap_queue_mtx);
+#else
+        g_cond_free(pcap_queue_cond);
+        g_mutex_free(pcap_queue_mtx);
+#endif
+        pcap_queue_cond = NULL;
+        pcap_queue_mtx = NULL;
     }
 
 
@@ -3972,7 +4099,9 @@ capture_loop_queue_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr
                              const u_char *pd)
 {
     pcap_options *pcap_opts = (pcap_options *) (void *) pcap_opts_p;
-    pcap_queue_element *queue_element;
+    pcap_ring *ring = &pcap_opts->ring;
+    pcap_ring_rec *rec;
+    guint rec_len, tail, used, offset, to_end;
     gboolean limit_reached;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
@@ -3983,49 +4112,57 @@ capture_loop_queue_packet_cb(u_char *pcap_opts_p, const struct pcap_pkthdr *phdr
         return;
     }
 
-    queue_element = (pcap_queue_element *)g_malloc(sizeof(pcap_queue_element));
-    if (queue_element == NULL) {
-       pcap_opts->dropped++;
-       return;
-    }
-    queue_element->pcap_opts = pcap_opts;
-    queue_element->phdr = *phdr;
-    queue_element->pd = (u_char *)g_malloc(phdr->caplen);
-    if (queue_element->pd == NULL) {
-        pcap_opts->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, phdr->caplen);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit > 0) && (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit > 0) && (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = FALSE;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += phdr->caplen;
-        pcap_queue_packets += 1;
+    rec_len = PCAP_RING_REC_LEN(phdr->caplen);
+    tail = (guint)ring->tail;
+    used = tail - (guint)g_atomic_int_get(&ring->head);
+    offset = tail & (ring->size - 1);
+    to_end = ring->size - offset;
+    if (((pcap_queue_byte_limit > 0) && (g_atomic_int_get(&pcap_queue_bytes) < pcap_queue_byte_limit)) &&
+        ((pcap_queue_packet_limit > 0) && (g_atomic_int_get(&pcap_queue_packets) < pcap_queue_packet_limit))) {
+        if (rec_len > to_end) {
+            /* Doesn't fit before the end of the ring; skip to the start. */
+            limit_reached = (used + to_end + rec_len > ring->size);
+            if (!limit_reached) {
+                ((pcap_ring_rec *)(void *)(ring->buf + offset))->rec_len = 0;
+                tail += to_end;
+                offset = 0;
+            }
+        } else {
+            limit_reached = (used + rec_len > ring->size);
+        }
     } else {
         limit_reached = TRUE;
     }
-    g_async_queue_unlock(pcap_queue);
     if (limit_reached) {
         pcap_opts->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
         g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
               "Dropped a packet of length %d captured on interface %u.",
               phdr->caplen, pcap_opts->interface_id);
-    } else {
-        pcap_opts->received++;
-        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-              "Queued a packet of length %d captured on interface %u.",
-              phdr->caplen, pcap_opts->interface_id);
+        return;
+    }
+
+    rec = (pcap_ring_rec *)(void *)(ring->buf + offset);
+    rec->rec_len = rec_len;
+    rec->phdr = *phdr;
+    memcpy(rec + 1, pd, phdr->caplen);
+    /* Publish the record only once it's been completely written. */
+    g_atomic_int_set(&ring->tail, (gint)(tail + rec_len));
+    g_atomic_int_add(&pcap_queue_bytes, (gint)phdr->caplen);
+    g_atomic_int_add(&pcap_queue_packets, 1);
+    pcap_opts->received++;
+    g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+          "Queued a packet of length %d captured on interface %u.",
+          phdr->caplen, pcap_opts->interface_id);
+
+    /* Wake up the writer thread if it's waiting for packets. */
+    if (g_atomic_int_get(&pcap_queue_writer_waiting)) {
+        g_mutex_lock(pcap_queue_mtx);
+        g_cond_signal(pcap_queue_cond);
+        g_mutex_unlock(pcap_queue_mtx);
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-          "Queue size is now %" G_GINT64_MODIFIER "d bytes (%" G_GINT64_MODIFIER "d packets)",
-          pcap_queue_bytes, pcap_queue_packets);
+          "Queue size is now %d bytes (%d packets)",
+          g_atomic_int_get(&pcap_queue_bytes), g_atomic_int_get(&pcap_queue_packets));
 }
 
 static int
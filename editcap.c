@@ -95,6 +95,31 @@ fd_hash_t fd_hash[MAX_DUP_DEPTH];
 int dup_window = DEFAULT_DUP_DEPTH;
 int cur_dup_entry = 0;
 
+/*
+ * Duplicate detection by time window (-w) keeps a hash table of the
+ * packets seen within the window, keyed by a fast 64-bit hash of their
+ * contents, along with a queue of the same packets in arrival order so
+ * that we can drop them as they fall out of the window.  The (masked)
+ * packet bytes follow each entry, so that packets whose hashes collide
+ * aren't taken for duplicates.
+ */
+typedef struct _dup_time_entry_t {
+  guint64 hash;
+  guint32 len;
+  nstime_t time;
+} dup_time_entry_t;
+
+#define DUP_TIME_ENTRY_DATA(entry) ((const guint8 *)((entry) + 1))
+
+static GHashTable *dup_time_table = NULL;
+static GQueue *dup_time_queue = NULL;
+static guint64 cur_dup_hash;
+
+/* Byte ranges that aren't compared when looking for duplicates (-I) */
+#define MAX_DUP_IGNORE 16
+static struct select_item dup_ignore[MAX_DUP_IGNORE];
+static int max_dup_ignore = -1;
+
 #define ONE_MILLION 1000000
 #define ONE_BILLION 1000000000
 
@@ -128,6 +153,7 @@ static int out_file_type = WTAP_FILE_PCAP;   /* default to pcap     */
 #endif
 static int out_frame_type = -2;              /* Leave frame type alone */
 static int verbose = 0;                      /* Not so verbose         */
+static gboolean compress_output = FALSE;     /* gzip the output file(s) */
 static struct time_adjustment time_adj = {{0, 0}, 0}; /* no adjustment */
 static nstime_t relative_time_window = {0, 0}; /* de-dup time window */
 static double err_prob = 0.0;
@@ -546,110 +572,137 @@ is_duplicate(guint8* fd, guint32 len) {
   return FALSE;
 }
 
+/*
+ * A MurmurHash64A-style hash; it only has to be the same for identical
+ * packets within one run, not across machines.
+ */
+static guint64
+dup_hash(const guint8 *fd, guint32 len)
+{
+  const guint64 m = G_GINT64_CONSTANT(0xc6a4a7935bd1e995U);
+  guint64 h = G_GINT64_CONSTANT(0x9e3779b97f4a7c15U) ^ (len * m);
+  guint64 k;
+  guint32 i;
+
+  for (i = 0; i + 8 <= len; i += 8) {
+    memcpy(&k, fd + i, 8);
+    k *= m;
+    k ^= k >> 47;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  if (i < len) {
+    k = 0;
+    memcpy(&k, fd + i, len - i);
+    h ^= k;
+    h *= m;
+  }
+  h ^= h >> 47;
+  h *= m;
+  h ^= h >> 47;
+  return h;
+}
+
+static guint
+dup_time_entry_hash(gconstpointer key)
+{
+  return (guint)((const dup_time_entry_t *)key)->hash;
+}
+
 static gboolean
-is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
-  int i;
-  md5_state_t ms;
+dup_time_entry_equal(gconstpointer a, gconstpointer b)
+{
+  const dup_time_entry_t *ea = (const dup_time_entry_t *)a;
+  const dup_time_entry_t *eb = (const dup_time_entry_t *)b;
 
-  cur_dup_entry++;
-  if (cur_dup_entry >= dup_window)
-    cur_dup_entry = 0;
+  return ea->hash == eb->hash && ea->len == eb->len &&
+         memcmp(DUP_TIME_ENTRY_DATA(ea), DUP_TIME_ENTRY_DATA(eb), ea->len) == 0;
+}
 
-  /* Calculate our digest */
-  md5_init(&ms);
-  md5_append(&ms, fd, len);
-  md5_finish(&ms, fd_hash[cur_dup_entry].digest);
+static gboolean
+is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
+  dup_time_entry_t *entry, *prev;
+  nstime_t delta;
+  gboolean dup = FALSE;
 
-  fd_hash[cur_dup_entry].len = len;
-  fd_hash[cur_dup_entry].time.secs = current->secs;
-  fd_hash[cur_dup_entry].time.nsecs = current->nsecs;
+  if (dup_time_table == NULL) {
+    dup_time_table = g_hash_table_new(dup_time_entry_hash, dup_time_entry_equal);
+    dup_time_queue = g_queue_new();
+  }
 
   /*
-   * Look for relative time related duplicates.
-   * This is hopefully a reasonably efficient mechanism for
-   * finding duplicates by rel time in the fd_hash[] cache.
-   * We check starting from the most recently added hash
-   * entries and work backwards towards older packets.
-   * This approach allows the dup test to be terminated
-   * when the relative time of a cached entry is found to
-   * be beyond the dup time window.
-   *
-   * Of course this assumes that the input trace file is
-   * "well-formed" in the sense that the packet timestamps are
-   * in strict chronologically increasing order (which is NOT
-   * always the case!!).
-   *
-   * The fd_hash[] table was deliberatly created large (1,000,000).
-   * Looking for time related duplicates in large trace files with
-   * non-fractional dup time window values can potentially take
-   * a long time to complete.
+   * Forget the packets that arrived more than the window before this
+   * one.  The queue is in arrival order, so if the packets aren't in
+   * chronological order some may linger a while, but they'll never
+   * match anything they shouldn't, as we check the time below.
    */
+  while ((entry = (dup_time_entry_t *)g_queue_peek_head(dup_time_queue)) != NULL) {
+    nstime_delta(&delta, current, &entry->time);
+    if (nstime_cmp(&delta, &relative_time_window) <= 0)
+      break;
+    g_queue_pop_head(dup_time_queue);
+    if (g_hash_table_lookup(dup_time_table, entry) == entry)
+      g_hash_table_remove(dup_time_table, entry);
+    g_free(entry);
+  }
 
-  for (i = cur_dup_entry - 1;; i--) {
-    nstime_t delta;
-    int cmp;
-
-    if (i < 0) {
-      i = dup_window - 1;
-    }
+  entry = (dup_time_entry_t *)g_malloc(sizeof(dup_time_entry_t) + len);
+  entry->hash = cur_dup_hash = dup_hash(fd, len);
+  entry->len = len;
+  entry->time = *current;
+  memcpy(entry + 1, fd, len);
 
-    if (i == cur_dup_entry) {
-      /*
-       * We've decremented back to where we started.
-       * Check no more!
-       */
-      break;
-    }
+  /*
+   * It's a duplicate if the last packet with the same contents arrived
+   * within the window before this one.  (A packet arriving *before* an
+   * earlier one isn't a duplicate of it; see the -w documentation.)
+   */
+  prev = (dup_time_entry_t *)g_hash_table_lookup(dup_time_table, entry);
+  if (prev != NULL) {
+    nstime_delta(&delta, current, &prev->time);
+    if (delta.secs >= 0 && delta.nsecs >= 0 &&
+        nstime_cmp(&delta, &relative_time_window) <= 0)
+      dup = TRUE;
+  }
 
-    if (nstime_is_unset(&(fd_hash[i].time))) {
-      /*
-       * We've decremented to an unused fd_hash[] entry.
-       * Check no more!
-       */
-      break;
-    }
+  /* This packet is now the one later copies get compared to. */
+  g_hash_table_replace(dup_time_table, entry, entry);
+  g_queue_push_tail(dup_time_queue, entry);
 
-    nstime_delta(&delta, current, &fd_hash[i].time);
+  return dup;
+}
 
-    if(delta.secs < 0 || delta.nsecs < 0)
-    {
-      /*
-       * A negative delta implies that the current packet
-       * has an absolute timestamp less than the cached packet
-       * that it is being compared to.  This is NOT a normal
-       * situation since trace files usually have packets in
-       * chronological order (oldest to newest).
-       *
-       * There are several possible ways to deal with this:
-       * 1. 'continue' dup checking with the next cached frame.
-       * 2. 'break' from looking for a duplicate of the current frame.
-       * 3. Take the absolute value of the delta and see if that
-       * falls within the specifed dup time window.
-       *
-       * Currently this code does option 1.  But it would pretty
-       * easy to add yet-another-editcap-option to select one of
-       * the other behaviors for dealing with out-of-sequence
-       * packets.
-       */
-      continue;
-    }
+/*
+ * If some bytes are to be ignored when looking for duplicates, zero
+ * them in a copy of the packet and return that.
+ */
+static guint8 *
+dup_mask_ignored(guint8 *fd, guint32 len)
+{
+  static guint8 *masked = NULL;
+  static guint32 masked_size = 0;
+  int i;
+  guint32 first, last;
 
-    cmp = nstime_cmp(&delta, &relative_time_window);
+  if (max_dup_ignore < 0)
+    return fd;
 
-    if(cmp > 0) {
-      /*
-       * The delta time indicates that we are now looking at
-       * cached packets beyond the specified dup time window.
-       * Check no more!
-       */
-      break;
-    } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len &&
-          memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-      return TRUE;
-    }
+  if (len > masked_size) {
+    masked_size = len;
+    masked = (guint8 *)g_realloc(masked, masked_size);
   }
-
-  return FALSE;
+  memcpy(masked, fd, len);
+  for (i = 0; i <= max_dup_ignore; i++) {
+    first = dup_ignore[i].first;
+    last = dup_ignore[i].inclusive ? (guint32)dup_ignore[i].second : first;
+    if (first >= len)
+      continue;
+    if (last >= len)
+      last = len - 1;
+    memset(masked + first, 0, last - first + 1);
+  }
+  return masked;
 }
 
 static void
@@ -692,6 +745,9 @@ usage(gboolean is_error)
   fprintf(output, "                         LESS THAN <dup time window> prior to current packet.\n");
   fprintf(output, "                         A <dup time window> is specified in relative seconds\n");
   fprintf(output, "                         (e.g. 0.000001).\n");
+  fprintf(output, "  -I <byte>[-<byte>]     ignore the given bytes (counting from 0) of each\n");
+  fprintf(output, "                         packet when looking for duplicates, e.g. an IP TTL\n");
+  fprintf(output, "                         and checksum. May be given up to %d times.\n", MAX_DUP_IGNORE);
   fprintf(output, "\n");
   fprintf(output, "           NOTE: The use of the 'Duplicate packet removal' options with\n");
   fprintf(output, "           other editcap options except -v may not always work as expected.\n");
@@ -728,13 +784,15 @@ usage(gboolean is_error)
   fprintf(output, "  -T <encap type>        set the output file encapsulation type;\n");
   fprintf(output, "                         default is the same as the input file.\n");
   fprintf(output, "                         an empty \"-T\" option will list the encapsulation types.\n");
+  fprintf(output, "  -z                     compress the output file(s) with gzip.\n");
   fprintf(output, "\n");
   fprintf(output, "Miscellaneous:\n");
   fprintf(output, "  -h                     display this help and exit.\n");
   fprintf(output, "  -v                     verbose output.\n");
   fprintf(output, "                         If -v is used with any of the 'Duplicate Packet\n");
   fprintf(output, "                         Removal' options (-d, -D or -w) then Packet lengths\n");
-  fprintf(output, "                         and MD5 hashes are printed to standard-out.\n");
+  fprintf(output, "                         and MD5 (or, with -w, 64-bit) hashes are printed to\n");
+  fprintf(output, "                         standard-out.\n");
   fprintf(output, "\n");
 }
 
@@ -820,6 +878,7 @@ main(int argc, char *argv[])
   int opt;
 
   char *p;
+  char *range_start;
   guint32 snaplen = 0;                  /* No limit               */
   int choplen = 0;                      /* No chop                */
   wtap_dumper *pdh = NULL;
@@ -869,7 +928,7 @@ main(int argc, char *argv[])
 #endif
 
   /* Process the options */
-  while ((opt = getopt(argc, argv, "A:B:c:C:dD:E:F:hrs:i:t:S:T:vw:")) !=-1) {
+  while ((opt = getopt(argc, argv, "A:B:c:C:dD:E:F:hI:rs:i:t:S:T:vw:z")) !=-1) {
 
     switch (opt) {
 
@@ -941,10 +1000,33 @@ main(int argc, char *argv[])
     case 'w':
       dup_detect = FALSE;
       dup_detect_by_time = TRUE;
-      dup_window = MAX_DUP_DEPTH;
       set_rel_time(optarg);
       break;
 
+    case 'I':
+      if (max_dup_ignore >= MAX_DUP_IGNORE - 1) {
+        fprintf(stderr, "editcap: Too many -I byte ranges; at most %d are allowed.\n",
+            MAX_DUP_IGNORE);
+        exit(1);
+      }
+      max_dup_ignore++;
+      dup_ignore[max_dup_ignore].inclusive = 0;
+      dup_ignore[max_dup_ignore].first = strtol(optarg, &p, 10);
+      range_start = optarg;
+      if (p != range_start && *p == '-') {
+        range_start = p + 1;
+        dup_ignore[max_dup_ignore].inclusive = 1;
+        dup_ignore[max_dup_ignore].second = strtol(range_start, &p, 10);
+      }
+      if (p == range_start || *p != '\0' || dup_ignore[max_dup_ignore].first < 0 ||
+          (dup_ignore[max_dup_ignore].inclusive &&
+           dup_ignore[max_dup_ignore].second < dup_ignore[max_dup_ignore].first)) {
+        fprintf(stderr, "editcap: \"%s\" isn't a valid byte range\n",
+            optarg);
+        exit(1);
+      }
+      break;
+
     case '?':              /* Bad options if GNU getopt */
       switch(optopt) {
       case'F':
@@ -1000,6 +1082,10 @@ main(int argc, char *argv[])
       verbose = !verbose;  /* Just invert */
       break;
 
+    case 'z':
+      compress_output = TRUE;
+      break;
+
     case 'i': /* break capture file based on time interval */
       secs_per_block = atoi(optarg);
       if(secs_per_block <= 0) {
@@ -1120,7 +1206,7 @@ main(int argc, char *argv[])
       if (add_selection(argv[i]) == FALSE)
         break;
 
-    if (dup_detect || dup_detect_by_time) {
+    if (dup_detect) {
       for (i = 0; i < dup_window; i++) {
         memset(&fd_hash[i].digest, 0, 16);
         fd_hash[i].len = 0;
@@ -1154,7 +1240,7 @@ main(int argc, char *argv[])
 
         pdh = wtap_dump_open_ng(filename, out_file_type, out_frame_type,
           snaplen ? MIN(snaplen, wtap_snapshot_length(wth)) : wtap_snapshot_length(wth),
-          FALSE /* compressed */, shb_hdr, idb_inf, &err);
+          compress_output, shb_hdr, idb_inf, &err);
 
         if (pdh == NULL) {
           fprintf(stderr, "editcap: Can't open or create %s: %s\n", filename,
@@ -1186,7 +1272,7 @@ main(int argc, char *argv[])
 
           pdh = wtap_dump_open_ng(filename, out_file_type, out_frame_type,
             snaplen ? MIN(snaplen, wtap_snapshot_length(wth)) : wtap_snapshot_length(wth),
-            FALSE /* compressed */, shb_hdr, idb_inf, &err);
+            compress_output, shb_hdr, idb_inf, &err);
 
           if (pdh == NULL) {
             fprintf(stderr, "editcap: Can't open or create %s: %s\n", filename,
@@ -1217,7 +1303,7 @@ main(int argc, char *argv[])
 
           pdh = wtap_dump_open_ng(filename, out_file_type, out_frame_type,
             snaplen ? MIN(snaplen, wtap_snapshot_length(wth)) : wtap_snapshot_length(wth),
-            FALSE /* compressed */, shb_hdr, idb_inf, &err);
+            compress_output, shb_hdr, idb_inf, &err);
           if (pdh == NULL) {
             fprintf(stderr, "editcap: Can't open or create %s: %s\n", filename,
                 wtap_strerror(err));
@@ -1357,7 +1443,7 @@ main(int argc, char *argv[])
 
         /* suppress duplicates by packet window */
         if (dup_detect) {
-          if (is_duplicate(buf, phdr->caplen)) {
+          if (is_duplicate(dup_mask_ignored(buf, phdr->caplen), phdr->caplen)) {
             if (verbose) {
               fprintf(stdout, "Skipped: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
               for (i = 0; i < 16; i++) {
@@ -1386,24 +1472,18 @@ main(int argc, char *argv[])
           current.secs = phdr->ts.secs;
           current.nsecs = phdr->ts.nsecs;
 
-          if (is_duplicate_rel_time(buf, phdr->caplen, &current)) {
+          if (is_duplicate_rel_time(dup_mask_ignored(buf, phdr->caplen), phdr->caplen, &current)) {
             if (verbose) {
-              fprintf(stdout, "Skipped: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
-              for (i = 0; i < 16; i++) {
-                fprintf(stdout, "%02x", (unsigned char)fd_hash[cur_dup_entry].digest[i]);
-              }
-              fprintf(stdout, "\n");
+              fprintf(stdout, "Skipped: %u, Len: %u, Hash: %016" G_GINT64_MODIFIER "x\n",
+                      count, phdr->caplen, cur_dup_hash);
             }
             duplicate_count++;
             count++;
             continue;
           } else {
             if (verbose) {
-              fprintf(stdout, "Packet: %u, Len: %u, MD5 Hash: ", count, phdr->caplen);
-              for (i = 0; i < 16; i++) {
-                fprintf(stdout, "%02x", (unsigned char)fd_hash[cur_dup_entry].digest[i]);
-              }
-              fprintf(stdout, "\n");
+              fprintf(stdout, "Packet: %u, Len: %u, Hash: %016" G_GINT64_MODIFIER "x\n",
+                      count, phdr->caplen, cur_dup_hash);
             }
           }
         }
@@ -1509,7 +1589,7 @@ main(int argc, char *argv[])
 
       pdh = wtap_dump_open_ng(filename, out_file_type, out_frame_type,
         snaplen ? MIN(snaplen, wtap_snapshot_length(wth)): wtap_snapshot_length(wth),
-        FALSE /* compressed */, shb_hdr, idb_inf, &err);
+        compress_output, shb_hdr, idb_inf, &err);
       if (pdh == NULL) {
         fprintf(stderr, "editcap: Can't open or create %s: %s\n", filename,
         wtap_strerror(err));
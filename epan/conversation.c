@@ -71,6 +71,22 @@ static conversation_key *conversation_keys;
 
 static guint32 new_index;
 
+/*
+ * If non-zero, conversations idle for this many seconds are taken out
+ * of the hash tables; see conversation_set_idle_timeout().
+ */
+static guint32 conversation_idle_timeout = 0;
+
+/* Time of the packet being dissected, and when next to look for idle
+ * conversations. */
+static time_t conversation_now;
+static time_t conversation_next_sweep;
+
+/* Routines to call for each retired conversation */
+static GSList *conversation_retire_routines = NULL;
+
+static void conversation_retire_idle(void);
+
 /*
  * Protocol-specific data attached to a conversation_t structure - protocol
  * index and opaque pointer.
@@ -176,6 +192,37 @@ conversation_create_from_template(conversation_t *conversation, const address *a
    }
 }
 
+/*
+ * Compute a hash value for an address/port pair.
+ *
+ * Simply adding up the bytes, as ADD_ADDRESS_TO_HASH() does, puts e.g.
+ * all the conversations between the hosts of a /24 and one server on a
+ * few hundred values; this spreads them over the whole range, using
+ * FNV-1a followed by the MurmurHash3 finalizer.
+ */
+static guint
+conversation_hash_endpoint(const address *addr, const guint32 port)
+{
+	const guint8 *data = (const guint8 *)addr->data;
+	guint32 hash_val = 2166136261U;
+	int i;
+
+	for (i = 0; i < addr->len; i++) {
+		hash_val ^= data[i];
+		hash_val *= 16777619U;
+	}
+	hash_val ^= port;
+	hash_val *= 16777619U;
+
+	hash_val ^= hash_val >> 16;
+	hash_val *= 0x85ebca6bU;
+	hash_val ^= hash_val >> 13;
+	hash_val *= 0xc2b2ae35U;
+	hash_val ^= hash_val >> 16;
+
+	return hash_val;
+}
+
 /*
  * Compute the hash value for two given address/port pairs if the match
  * is to be exact.
@@ -184,15 +231,10 @@ static guint
 conversation_hash_exact(gconstpointer v)
 {
 	const conversation_key *key = (const conversation_key *)v;
-	guint hash_val;
-
-	hash_val = 0;
-	ADD_ADDRESS_TO_HASH(hash_val, &key->addr1);
-	hash_val += key->port1;
-	ADD_ADDRESS_TO_HASH(hash_val, &key->addr2);
-	hash_val += key->port2;
 
-	return hash_val;
+	/* Matches go both ways, so the order mustn't matter. */
+	return conversation_hash_endpoint(&key->addr1, key->port1) +
+	    conversation_hash_endpoint(&key->addr2, key->port2);
 }
 
 /*
@@ -257,10 +299,8 @@ conversation_hash_no_addr2(gconstpointer v)
 	const conversation_key *key = (const conversation_key *)v;
 	guint hash_val;
 
-	hash_val = 0;
-	ADD_ADDRESS_TO_HASH(hash_val, &key->addr1);
-	hash_val += key->port1;
-	hash_val += key->port2;
+	hash_val = conversation_hash_endpoint(&key->addr1, key->port1);
+	hash_val ^= key->port2 * 2654435761U;
 
 	return hash_val;
 }
@@ -311,10 +351,8 @@ conversation_hash_no_port2(gconstpointer v)
 	const conversation_key *key = (const conversation_key *)v;
 	guint hash_val;
 
-	hash_val = 0;
-	ADD_ADDRESS_TO_HASH(hash_val, &key->addr1);
-	hash_val += key->port1;
-	ADD_ADDRESS_TO_HASH(hash_val, &key->addr2);
+	hash_val = conversation_hash_endpoint(&key->addr1, key->port1);
+	hash_val = hash_val * 31 + conversation_hash_endpoint(&key->addr2, 0);
 
 	return hash_val;
 }
@@ -365,9 +403,7 @@ conversation_hash_no_addr2_or_port2(gconstpointer v)
 	const conversation_key *key = (const conversation_key *)v;
 	guint hash_val;
 
-	hash_val = 0;
-	ADD_ADDRESS_TO_HASH(hash_val, &key->addr1);
-	hash_val += key->port1;
+	hash_val = conversation_hash_endpoint(&key->addr1, key->port1);
 
 	return hash_val;
 }
@@ -488,6 +524,8 @@ conversation_init(void)
 	 * Start the conversation indices over at 0.
 	 */
 	new_index = 0;
+
+	conversation_next_sweep = 0;
 }
 
 /*
@@ -557,6 +595,11 @@ conversation_remove_from_hashtable(GHashTable *hashtable, conversation_t *conv)
 
 	chain_head = (conversation_t *)g_hash_table_lookup(hashtable, conv->key_ptr);
 
+	if (chain_head == NULL) {
+		/* Not in this table; it may have been retired for being idle */
+		return;
+	}
+
 	if (conv == chain_head) {
 		/* We are currently the front of the chain */
 		if (NULL == conv->next) {
@@ -623,6 +666,8 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	conversation_t *conversation=NULL;
 	conversation_key *new_key;
 
+	conversation_retire_idle();
+
 	if (options & NO_ADDR2) {
 		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
 			hashtable = conversation_hashtable_no_addr2_or_port2;
@@ -660,6 +705,8 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	conversation->options = options;
 	conversation->key_ptr = new_key;
 
+	conversation->last_seen = conversation_now;
+
 	new_index++;
 
 	conversation_insert_into_hashtable(hashtable, conversation);
@@ -683,6 +730,12 @@ conversation_set_port2(conversation_t *conv, const guint32 port)
 	if ((!(conv->options & NO_PORT2)) || (conv->options & NO_PORT2_FORCE))
 		return;
 
+	/*
+	 * A retired conversation is in no table any more, and must stay out.
+	 */
+	if (conv->retired)
+		return;
+
 	if (conv->options & NO_ADDR2) {
 		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
 	} else {
@@ -713,6 +766,12 @@ conversation_set_addr2(conversation_t *conv, const address *addr)
 	if (!(conv->options & NO_ADDR2))
 		return;
 
+	/*
+	 * A retired conversation is in no table any more, and must stay out.
+	 */
+	if (conv->retired)
+		return;
+
 	if (conv->options & NO_PORT2) {
 		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
 	} else {
@@ -755,8 +814,12 @@ conversation_lookup_hashtable(GHashTable *hashtable, const guint32 frame_num, co
 	if (chain_head && (chain_head->setup_frame <= frame_num)) {
 		match = chain_head;
 
-		if((chain_head->last)&&(chain_head->last->setup_frame<=frame_num))
-			return chain_head->last;
+		if((chain_head->last)&&(chain_head->last->setup_frame<=frame_num)) {
+			match = chain_head->last;
+			match->last_seen = conversation_now;
+			conversation_retire_idle();
+			return match;
+		}
 
 		if((chain_head->latest_found)&&(chain_head->latest_found->setup_frame<=frame_num))
 			match = chain_head->latest_found;
@@ -768,8 +831,11 @@ conversation_lookup_hashtable(GHashTable *hashtable, const guint32 frame_num, co
 		}
 	}
 
-    if (match)
+    if (match) {
     	chain_head->latest_found = match;
+    	match->last_seen = conversation_now;
+    	conversation_retire_idle();
+    }
 
 	return match;
 }
@@ -1251,3 +1317,90 @@ find_or_create_conversation(packet_info *pinfo)
 
 	return conv;
 }
+
+/*
+ * Retire the conversations with this key if none of them has been seen
+ * since the cutoff time.
+ */
+static gboolean
+conversation_chain_is_idle(gpointer key _U_, gpointer value, gpointer user_data)
+{
+	conversation_t *conv, *next;
+	GSList *routine;
+	const time_t cutoff = *(const time_t *)user_data;
+
+	for (conv = (conversation_t *)value; conv != NULL; conv = conv->next) {
+		if (conv->last_seen >= cutoff)
+			return FALSE;
+	}
+	for (conv = (conversation_t *)value; conv != NULL; conv = next) {
+		for (routine = conversation_retire_routines; routine != NULL;
+		    routine = g_slist_next(routine))
+			((conversation_retire_func)routine->data)(conv);
+		/* Unlink it, so that nothing can follow it into the old chain */
+		next = conv->next;
+		conv->next = NULL;
+		conv->last = NULL;
+		conv->latest_found = NULL;
+		conv->retired = TRUE;
+	}
+	/*
+	 * The conversations themselves are se_allocated, and dissectors
+	 * may still have pointers to them and their data, so we leave them
+	 * alone.
+	 */
+	return TRUE;
+}
+
+void
+register_conversation_retire_routine(conversation_retire_func func)
+{
+	conversation_retire_routines = g_slist_append(conversation_retire_routines,
+	    (gpointer)func);
+}
+
+void
+conversation_set_idle_timeout(const guint32 idle_timeout)
+{
+	conversation_idle_timeout = idle_timeout;
+	conversation_next_sweep = 0;
+}
+
+void
+conversation_set_packet_time(const nstime_t *abs_ts)
+{
+	conversation_now = abs_ts->secs;
+}
+
+/*
+ * If it's time to, retire the conversations that have been idle for too
+ * long.  This is done when a conversation is found or created, rather
+ * than for every packet.
+ */
+static void
+conversation_retire_idle(void)
+{
+	time_t cutoff;
+
+	if (conversation_idle_timeout == 0 || conversation_now < conversation_next_sweep)
+		return;
+
+	if (conversation_next_sweep != 0) {
+		cutoff = conversation_now - conversation_idle_timeout;
+		if (conversation_hashtable_exact != NULL)
+			g_hash_table_foreach_remove(conversation_hashtable_exact,
+			    conversation_chain_is_idle, &cutoff);
+		if (conversation_hashtable_no_addr2 != NULL)
+			g_hash_table_foreach_remove(conversation_hashtable_no_addr2,
+			    conversation_chain_is_idle, &cutoff);
+		if (conversation_hashtable_no_port2 != NULL)
+			g_hash_table_foreach_remove(conversation_hashtable_no_port2,
+			    conversation_chain_is_idle, &cutoff);
+		if (conversation_hashtable_no_addr2_or_port2 != NULL)
+			g_hash_table_foreach_remove(conversation_hashtable_no_addr2_or_port2,
+			    conversation_chain_is_idle, &cutoff);
+	}
+	/* Look again after half the timeout, so that a conversation is
+	 * retired at most one and a half timeouts after its last packet. */
+	conversation_next_sweep = conversation_now + (conversation_idle_timeout + 1) / 2;
+}
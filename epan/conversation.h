@@ -81,6 +81,8 @@ typedef struct conversation {
 								/** handle for protocol dissector client associated with conversation */
 	guint	options;			/** wildcard flags */
 	conversation_key *key_ptr;	/** pointer to the key for this conversation */
+	time_t	last_seen;			/** time of the last packet found in this conversation */
+	gboolean retired;			/** taken out of the hash tables for being idle */
 } conversation_t;
 
 /**
@@ -179,6 +181,30 @@ try_conversation_dissector(const address *addr_a, const address *addr_b, const p
 extern void conversation_set_port2(conversation_t *conv, const guint32 port);
 extern void conversation_set_addr2(conversation_t *conv, const address *addr);
 
+/**
+ * Retire conversations in which no packet has been seen for idle_timeout
+ * seconds, i.e. take them out of the conversation tables so that they're
+ * never found again; a later packet between the same endpoints starts a
+ * new conversation.  Only use this when the packets are dissected once,
+ * in order: dissecting an earlier packet again after its conversation
+ * has been retired gives different results.  0, the default, turns it off.
+ */
+extern void conversation_set_idle_timeout(const guint32 idle_timeout);
+
+/**
+ * Register a routine to be called for each conversation that is retired
+ * for being idle, so that anything kept for it can be freed.
+ */
+typedef void (*conversation_retire_func)(conversation_t *conv);
+extern void register_conversation_retire_routine(conversation_retire_func func);
+
+/**
+ * Tell the conversation code the time of the packet about to be dissected,
+ * so that it can tell how long conversations have been idle.  Only needed
+ * if an idle timeout has been set.
+ */
+extern void conversation_set_packet_time(const nstime_t *abs_ts);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -40,6 +40,7 @@ struct _dfilter_t {
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
+	GPtrArray	*terms;		/* canonical text of each top-level "and" term */
 };
 
 typedef struct {
@@ -69,6 +70,9 @@ void Dfilter(void*, int, stnode_t*, dfwork_t*);
 /* Scanner's lval */
 extern stnode_t *df_lval;
 
+gboolean
+df_scanner_term_add(GString *term, int *depth, int token, stnode_t *node);
+
 /* Return value for error in scanner. */
 #define SCAN_FAILED	-1	/* not 0, as that means end-of-input */
 
@@ -118,6 +118,17 @@ dfilter_new(void)
 	return df;
 }
 
+static void
+free_terms(GPtrArray *terms)
+{
+	guint i;
+
+	for (i = 0; i < terms->len; i++) {
+		g_free(g_ptr_array_index(terms, i));
+	}
+	g_ptr_array_free(terms, TRUE);
+}
+
 /* Given a GPtrArray of instructions (dfvm_insn_t),
  * free them. */
 static void
@@ -165,6 +176,10 @@ dfilter_free(dfilter_t *df)
 		g_ptr_array_free(df->deprecated, TRUE);
 	}
 
+	if (df->terms) {
+		free_terms(df->terms);
+	}
+
 	g_free(df->registers);
 	g_free(df->attempted_load);
 	g_free(df);
@@ -218,6 +233,9 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 	const char	*depr_test;
 	guint		i;
 	GPtrArray	*deprecated;
+	GPtrArray	*terms;
+	GString		*term;
+	int		depth = 0;
 
 	g_assert(dfp);
 
@@ -237,6 +255,8 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 	df_scanner_text(text);
 
 	deprecated = g_ptr_array_new();
+	terms = g_ptr_array_new();
+	term = g_string_new("");
 
 	while (1) {
 		df_lval = stnode_new(STTYPE_UNINITIALIZED, NULL);
@@ -269,6 +289,12 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 			g_ptr_array_add(deprecated, g_strdup(depr_test));
 		}
 
+		/* Remember the filter's top-level "and" terms */
+		if (df_scanner_term_add(term, &depth, token, df_lval)) {
+			g_ptr_array_add(terms, g_string_free(term, FALSE));
+			term = g_string_new("");
+		}
+
 		/* Give the token to the parser */
 		Dfilter(ParserObj, token, df_lval, dfw);
 		/* We've used the stnode_t, so we don't want to free it */
@@ -303,6 +329,8 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 	/* Reset flex */
 	df_scanner_cleanup();
 
+	g_ptr_array_add(terms, g_string_free(term, FALSE));
+
 	if (failure)
 		goto FAILURE;
 
@@ -315,6 +343,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 			g_free(depr);
 		}
 		g_ptr_array_free(deprecated, TRUE);
+		free_terms(terms);
 	}
 	else {
 
@@ -347,6 +376,8 @@ dfilter_compile(const gchar *text, dfilter_t **dfp)
 		/* Add any deprecated items */
 		dfilter->deprecated = deprecated;
 
+		dfilter->terms = terms;
+
 		/* And give it to the user. */
 		*dfp = dfilter;
 	}
@@ -363,6 +394,7 @@ FAILURE:
 		g_free(depr);
 	}
 	g_ptr_array_free(deprecated, TRUE);
+	free_terms(terms);
 	dfilter_fail("Unable to parse filter string \"%s\".", text);
 	*dfp = NULL;
 	return FALSE;
@@ -393,6 +425,34 @@ dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree)
     }
 }
 
+const int *
+dfilter_interesting_fields(const dfilter_t *df, int *num_fields)
+{
+    *num_fields = df->num_interesting_fields;
+    return df->interesting_fields;
+}
+
+gboolean
+dfilter_narrows(const dfilter_t *df, const dfilter_t *prev)
+{
+	guint i, j;
+
+	if (!df || !prev)
+		return FALSE;
+
+	/* Every term of prev has to be a term of df */
+	for (i = 0; i < prev->terms->len; i++) {
+		for (j = 0; j < df->terms->len; j++) {
+			if (strcmp((const char *)g_ptr_array_index(prev->terms, i),
+			    (const char *)g_ptr_array_index(df->terms, j)) == 0)
+				break;
+		}
+		if (j == df->terms->len)
+			return FALSE;
+	}
+	return TRUE;
+}
+
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df) {
 	if (df->deprecated && df->deprecated->len > 0) {
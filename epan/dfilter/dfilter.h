@@ -86,6 +86,17 @@ dfilter_apply(dfilter_t *df, proto_tree *tree);
 void
 dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree);
 
+/* Get the fields/protocols used in a dfilter, i.e. the ones that
+ * dfilter_prime_proto_tree() primes. */
+const int *
+dfilter_interesting_fields(const dfilter_t *df, int *num_fields);
+
+/* Returns TRUE if df can only accept packets that prev also accepts,
+ * because df is prev "and"ed with more terms.  This is a purely
+ * syntactic test, so it may miss some filters that do narrow prev. */
+gboolean
+dfilter_narrows(const dfilter_t *df, const dfilter_t *prev);
+
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df);
 
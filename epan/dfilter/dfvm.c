@@ -369,6 +369,48 @@ any_test(dfilter_t *df, FvalueCmpFunc cmp, int reg1, int reg2)
 	return FALSE;
 }
 
+/* any_test(df, fvalue_eq, ...), with the commonest comparisons --
+ * unsigned integers and IPv4 addresses -- done inline rather than
+ * through the ftype's cmp_eq function. */
+static gboolean
+any_eq(dfilter_t *df, int reg1, int reg2)
+{
+	GList		*list_a, *list_b;
+	fvalue_t	*fv_a, *fv_b;
+	guint32		nmask;
+
+	for (list_a = df->registers[reg1]; list_a; list_a = g_list_next(list_a)) {
+		fv_a = (fvalue_t *)list_a->data;
+		for (list_b = df->registers[reg2]; list_b; list_b = g_list_next(list_b)) {
+			fv_b = (fvalue_t *)list_b->data;
+			if (fv_a->ftype == fv_b->ftype) {
+				switch (fv_a->ftype->ftype) {
+					case FT_UINT8:
+					case FT_UINT16:
+					case FT_UINT24:
+					case FT_UINT32:
+						if (fv_a->value.uinteger == fv_b->value.uinteger)
+							return TRUE;
+						continue;
+
+					case FT_IPv4:
+						/* as ipv4_addr_eq() */
+						nmask = MIN(fv_a->value.ipv4.nmask, fv_b->value.ipv4.nmask);
+						if ((fv_a->value.ipv4.addr & nmask) == (fv_b->value.ipv4.addr & nmask))
+							return TRUE;
+						continue;
+
+					default:
+						break;
+				}
+			}
+			if (fvalue_eq(fv_a, fv_b)) {
+				return TRUE;
+			}
+		}
+	}
+	return FALSE;
+}
 
 /* Free the list nodes w/o freeing the memory that each
  * list node points to. */
@@ -483,7 +525,7 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 				break;
 
 			case ANY_EQ:
-				accum = any_test(df, fvalue_eq,
+				accum = any_eq(df,
 						arg1->value.numeric, arg2->value.numeric);
 				break;
 
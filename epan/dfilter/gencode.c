@@ -317,6 +317,126 @@ gen_entity(dfwork_t *dfw, stnode_t *st_arg, dfvm_value_t **p_jmp)
 }
 
 
+/* Rough relative cost of computing an entity's value(s). */
+static int
+entity_cost(stnode_t *st_arg)
+{
+	switch (stnode_type_id(st_arg)) {
+		case STTYPE_FIELD:
+			return 2;
+		case STTYPE_RANGE:
+			return 4;
+		case STTYPE_FUNCTION:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+/* Rough relative cost of evaluating a test.  We use it to evaluate
+ * the cheaper side of an "and" or an "or" first, so that the more
+ * expensive side is often skipped. */
+static int
+test_cost(stnode_t *st_node)
+{
+	test_op_t	st_op;
+	stnode_t	*st_arg1, *st_arg2;
+	int		cost;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	switch (st_op) {
+		case TEST_OP_EXISTS:
+			return 1;
+
+		case TEST_OP_NOT:
+			return test_cost(st_arg1);
+
+		case TEST_OP_AND:
+		case TEST_OP_OR:
+			return test_cost(st_arg1) + test_cost(st_arg2);
+
+		default:
+			cost = 1 + entity_cost(st_arg1) + entity_cost(st_arg2);
+			if (st_op == TEST_OP_CONTAINS)
+				cost += 4;
+			else if (st_op == TEST_OP_MATCHES)
+				cost += 16;
+			return cost;
+	}
+}
+
+static header_field_info *
+first_of_name(header_field_info *hfinfo)
+{
+	while (hfinfo->same_name_prev) {
+		hfinfo = hfinfo->same_name_prev;
+	}
+	return hfinfo;
+}
+
+/* Returns the fields (the first of each set of fields with the same
+ * name) that must be in the tree for the test to pass. */
+static GSList *
+required_fields(stnode_t *st_node)
+{
+	test_op_t	st_op;
+	stnode_t	*st_arg1, *st_arg2;
+	GSList		*req1, *req2, *req, *l;
+	header_field_info *hfinfo;
+
+	sttype_test_get(st_node, &st_op, &st_arg1, &st_arg2);
+
+	switch (st_op) {
+		case TEST_OP_UNINITIALIZED:
+		case TEST_OP_NOT:
+			return NULL;
+
+		case TEST_OP_EXISTS:
+			return g_slist_prepend(NULL,
+			    first_of_name((header_field_info*)stnode_data(st_arg1)));
+
+		case TEST_OP_AND:
+			/* Everything either side needs */
+			req1 = required_fields(st_arg1);
+			req2 = required_fields(st_arg2);
+			for (l = req2; l != NULL; l = l->next) {
+				if (!g_slist_find(req1, l->data))
+					req1 = g_slist_append(req1, l->data);
+			}
+			g_slist_free(req2);
+			return req1;
+
+		case TEST_OP_OR:
+			/* Only what both sides need */
+			req1 = required_fields(st_arg1);
+			req2 = required_fields(st_arg2);
+			req = NULL;
+			for (l = req1; l != NULL; l = l->next) {
+				if (g_slist_find(req2, l->data))
+					req = g_slist_append(req, l->data);
+			}
+			g_slist_free(req1);
+			g_slist_free(req2);
+			return req;
+
+		default:
+			/* A relation is false if a field it compares is
+			 * absent.  (Fields inside ranges and function calls
+			 * are left out, to keep this simple.) */
+			req = NULL;
+			if (stnode_type_id(st_arg1) == STTYPE_FIELD)
+				req = g_slist_append(req,
+				    first_of_name((header_field_info*)stnode_data(st_arg1)));
+			if (stnode_type_id(st_arg2) == STTYPE_FIELD) {
+				hfinfo = first_of_name((header_field_info*)stnode_data(st_arg2));
+				if (!g_slist_find(req, hfinfo))
+					req = g_slist_append(req, hfinfo);
+			}
+			return req;
+	}
+}
+
 static void
 gen_test(dfwork_t *dfw, stnode_t *st_node)
 {
@@ -364,6 +484,11 @@ gen_test(dfwork_t *dfw, stnode_t *st_node)
 			break;
 
 		case TEST_OP_AND:
+			if (test_cost(st_arg2) < test_cost(st_arg1)) {
+				stnode_t *st_tmp = st_arg1;
+				st_arg1 = st_arg2;
+				st_arg2 = st_tmp;
+			}
 			gencode(dfw, st_arg1);
 
 			insn = dfvm_insn_new(IF_FALSE_GOTO);
@@ -376,6 +501,11 @@ gen_test(dfwork_t *dfw, stnode_t *st_node)
 			break;
 
 		case TEST_OP_OR:
+			if (test_cost(st_arg2) < test_cost(st_arg1)) {
+				stnode_t *st_tmp = st_arg1;
+				st_arg1 = st_arg2;
+				st_arg2 = st_tmp;
+			}
 			gencode(dfw, st_arg1);
 
 			insn = dfvm_insn_new(IF_TRUE_GOTO);
@@ -448,12 +578,40 @@ dfw_gencode(dfwork_t *dfw)
 	int		id, id1, length;
 	dfvm_insn_t	*insn, *insn1, *prev;
 	dfvm_value_t	*arg1;
+	GSList		*required, *l, *prefilter_jmps = NULL;
 
 	dfw->insns = g_ptr_array_new();
 	dfw->consts = g_ptr_array_new();
 	dfw->loaded_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
 	dfw->interesting_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	/* If the filter can't pass without several fields, first check
+	 * that they're all there, so that a packet lacking one of them
+	 * (e.g. a UDP packet for "ip.addr==10.0.0.1 && tcp.port==443")
+	 * is rejected before we read and compare any of the others. */
+	required = required_fields(dfw->st_root);
+	if (g_slist_length(required) > 1) {
+		for (l = required; l != NULL; l = l->next) {
+			insn = dfvm_insn_new(CHECK_EXISTS);
+			insn->arg1 = dfvm_value_new(HFINFO);
+			insn->arg1->value.hfinfo = (header_field_info *)l->data;
+			dfw_append_insn(dfw, insn);
+
+			insn = dfvm_insn_new(IF_FALSE_GOTO);
+			insn->arg1 = dfvm_value_new(INSN_NUMBER);
+			dfw_append_insn(dfw, insn);
+			prefilter_jmps = g_slist_prepend(prefilter_jmps, insn->arg1);
+		}
+	}
+	g_slist_free(required);
+
 	gencode(dfw, dfw->st_root);
+
+	/* The prefilter's failures go straight to the RETURN */
+	for (l = prefilter_jmps; l != NULL; l = l->next) {
+		((dfvm_value_t *)l->data)->value.numeric = dfw->next_insn_id;
+	}
+	g_slist_free(prefilter_jmps);
 	dfw_append_insn(dfw, dfvm_insn_new(RETURN));
 
 	/* fixup goto */
@@ -1639,7 +1639,6 @@ dissect_artnet_output(tvbuff_t *tvb, guint offset, proto_tree *tree, packet_info
 
   next_tvb = tvb_new_subset(tvb, offset, length, length);
 
-  /* XXX: Assumption: OK to call dmx-chan dissector under 'if (tree)' */
   call_dissector(dmx_chan_handle, next_tvb, pinfo, base_tree);
 
   col_set_writable(pinfo->cinfo, save_info);
@@ -2072,7 +2071,6 @@ dissect_artnet_rdm(tvbuff_t *tvb, guint offset, proto_tree *tree,  packet_info *
 
   next_tvb = tvb_new_subset_remaining(tvb, offset);
 
-  /* XXX: Assumption: OK to call rdm dissector under 'if (tree)' */
   call_dissector(rdm_handle, next_tvb, pinfo, base_tree);
 
   col_set_writable(pinfo->cinfo, save_info);
@@ -2578,21 +2576,20 @@ dissect_artnet(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree) {
       break;
 
     case ARTNET_OP_OUTPUT:
-      if (tree) {
-        hi = proto_tree_add_item(artnet_tree,
-                                 hf_artnet_output,
-                                 tvb,
-                                 offset,
-                                 0,
-                                 ENC_NA);
-
-        si = proto_item_add_subtree(hi, ett_artnet);
-
-        size  = dissect_artnet_output( tvb, offset, si, pinfo, tree);
-        size -= offset;
-        proto_item_set_len(si, size );
-        offset += size;
-      }
+      /* Not under 'if (tree)', as it hands the DMX data to another dissector */
+      hi = proto_tree_add_item(artnet_tree,
+                               hf_artnet_output,
+                               tvb,
+                               offset,
+                               0,
+                               ENC_NA);
+
+      si = proto_item_add_subtree(hi, ett_artnet);
+
+      size  = dissect_artnet_output( tvb, offset, si, pinfo, tree);
+      size -= offset;
+      proto_item_set_len(si, size );
+      offset += size;
       break;
 
 
@@ -2691,20 +2688,19 @@ dissect_artnet(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree) {
       break;
 
     case ARTNET_OP_RDM:
-      if (tree) {
-        hi = proto_tree_add_item(artnet_tree,
-                                 hf_artnet_rdm,
-                                 tvb,
-                                 offset,
-                                 0,
-                                 ENC_NA);
-        si = proto_item_add_subtree(hi, ett_artnet);
-        size  = dissect_artnet_rdm(tvb, offset, si, pinfo, tree);
-        size -= offset;
-
-        proto_item_set_len( si, size );
-        offset += size;
-      }
+      /* Not under 'if (tree)', as it hands the RDM data to another dissector */
+      hi = proto_tree_add_item(artnet_tree,
+                               hf_artnet_rdm,
+                               tvb,
+                               offset,
+                               0,
+                               ENC_NA);
+      si = proto_item_add_subtree(hi, ett_artnet);
+      size  = dissect_artnet_rdm(tvb, offset, si, pinfo, tree);
+      size -= offset;
+
+      proto_item_set_len( si, size );
+      offset += size;
       break;
 
     case ARTNET_OP_RDM_SUB:
@@ -1167,7 +1167,7 @@ dissect_reassembled_pdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree,
             }
         }
 
-        if (tree && !decoded) {
+        if (!decoded) {
             /* Dump it as raw data. */
             call_dissector(data_handle, next_tvb, pinfo, tree);
         }
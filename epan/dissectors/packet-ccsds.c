@@ -323,18 +323,18 @@ dissect_ccsds(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 	reported_length = tvb_reported_length_remaining(tvb, 0);
 	ccsds_length    = tvb_get_ntohs(tvb, 4) + CCSDS_PRIMARY_HEADER_LENGTH + 1;
 
-	if (tree) {
-		/* Min length is size of headers, whereas max length is reported length.
-		 * If the length field in the CCSDS header is outside of these bounds,
-		 * use the value it violates.  Otherwise, use the length field value.
-		 */
-		if (ccsds_length > reported_length)
-			length = reported_length;
-		else if (ccsds_length < CCSDS_PRIMARY_HEADER_LENGTH + CCSDS_SECONDARY_HEADER_LENGTH)
-			length = CCSDS_PRIMARY_HEADER_LENGTH + CCSDS_SECONDARY_HEADER_LENGTH;
-		else
-			length = ccsds_length;
+	/* Min length is size of headers, whereas max length is reported length.
+	 * If the length field in the CCSDS header is outside of these bounds,
+	 * use the value it violates.  Otherwise, use the length field value.
+	 */
+	if (ccsds_length > reported_length)
+		length = reported_length;
+	else if (ccsds_length < CCSDS_PRIMARY_HEADER_LENGTH + CCSDS_SECONDARY_HEADER_LENGTH)
+		length = CCSDS_PRIMARY_HEADER_LENGTH + CCSDS_SECONDARY_HEADER_LENGTH;
+	else
+		length = ccsds_length;
 
+	if (tree) {
 		ccsds_packet = proto_tree_add_item(tree, proto_ccsds, tvb, 0, length, ENC_NA);
 		ccsds_tree   = proto_item_add_subtree(ccsds_packet, ett_ccsds);
 
@@ -483,13 +483,11 @@ dissect_ccsds(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 				offset += 2;
 			}
 		}
-
-		/* Give the data dissector any bytes past the CCSDS packet length */
-		/* (XXX: Not really OK under 'if (tree)' but will work; see packet-data.c */
-		call_dissector(data_handle, tvb_new_subset_remaining(tvb, offset), pinfo, tree);
-
 	} /* if(tree) */
 
+	/* Give the data dissector any bytes past the CCSDS packet length */
+	call_dissector(data_handle, tvb_new_subset_remaining(tvb, length), pinfo, tree);
+
 }
 
 
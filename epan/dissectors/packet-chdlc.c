@@ -314,11 +314,10 @@ dissect_slarp(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 
   default:
     col_add_fstr(pinfo->cinfo, COL_INFO, "Unknown packet type 0x%08X", code);
-    if (tree) {
+    if (tree)
       proto_tree_add_uint(slarp_tree, hf_slarp_ptype, tvb, 0, 4, code);
-      call_dissector(data_handle, tvb_new_subset_remaining(tvb, 4), pinfo,
-                     slarp_tree);
-    }
+    call_dissector(data_handle, tvb_new_subset_remaining(tvb, 4), pinfo,
+                   slarp_tree);
     break;
   }
 }
@@ -501,7 +501,7 @@ dissect_dsi_reply_get_status(tvbuff_t *tvb, proto_tree *tree, gint offset)
 static void
 dissect_dsi_packet(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 {
-	proto_tree      *dsi_tree;
+	proto_tree      *dsi_tree = NULL;
 	proto_item	*ti;
 	guint8		dsi_flags,dsi_command;
 	guint16		dsi_requestid;
@@ -601,11 +601,9 @@ dissect_dsi_packet(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 		}
 		break;
 	default:
-		if (tree) {
-			call_dissector(data_handle,
-				       tvb_new_subset_remaining(tvb, DSI_BLOCKSIZ),
-				       pinfo, dsi_tree);
-		}
+		call_dissector(data_handle,
+			       tvb_new_subset_remaining(tvb, DSI_BLOCKSIZ),
+			       pinfo, dsi_tree);
 		break;
 	}
 }
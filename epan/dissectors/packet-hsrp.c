@@ -589,10 +589,8 @@ dissect_hsrp(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_
                                 }
                         } else {
                                 /* Undefined TLV */
-				if (tree) {
-        				next_tvb = tvb_new_subset_remaining(tvb, offset);
-        				call_dissector(data_handle, next_tvb, pinfo, hsrp_tree);
-				}
+				next_tvb = tvb_new_subset_remaining(tvb, offset);
+				call_dissector(data_handle, next_tvb, pinfo, hsrp_tree);
                                 break;
 			}
 		        offset = offset2+len+2;
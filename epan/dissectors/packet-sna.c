@@ -1126,9 +1126,8 @@ dissect_optional(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 
 		/* Prevent loop for invalid crap in packet */
 		if (len == 0) {
-			if (tree)
-				call_dissector(data_handle,
-				    tvb_new_subset_remaining(tvb, offset), pinfo, tree);
+			call_dissector(data_handle,
+			    tvb_new_subset_remaining(tvb, offset), pinfo, tree);
 			return;
 		}
 
@@ -247,8 +247,7 @@ dissect_vjuc(tvbuff_t *tvb, packet_info *pinfo, proto_tree * tree)
      * non-decompressable.
      */
     col_set_str(pinfo->cinfo, COL_INFO, "VJ uncompressed TCP (not enough data available)");
-    if(tree != NULL)
-      call_dissector(data_handle, tvb, pinfo, tree);
+    call_dissector(data_handle, tvb, pinfo, tree);
     if(comp != NULL) {
       for(i = 0; i < TCP_SIMUL_CONV_MAX; i++)
         comp->rstate[i].flags |= SLF_TOSS;
@@ -288,8 +287,7 @@ dissect_vjuc(tvbuff_t *tvb, packet_info *pinfo, proto_tree * tree)
   /* Make sure we have the full IP header */
   if(isize < ihl) {
     col_set_str(pinfo->cinfo, COL_INFO, "VJ uncompressed TCP (not enough data available)");
-    if(tree != NULL)
-      call_dissector(data_handle, tvb, pinfo, tree);
+    call_dissector(data_handle, tvb, pinfo, tree);
     if(cs != NULL)
       cs->flags |= SLF_TOSS;
     return;
@@ -423,8 +421,7 @@ dissect_vjc(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
   /* Decompression possible - set up tvb containing decompressed packet */
   err = vjc_tvb_setup(tvb, &next_tvb, pinfo);
   if(err == VJ_ERROR) {
-    if(tree != NULL)
-      call_dissector(data_handle, tvb, pinfo, vj_tree);
+    call_dissector(data_handle, tvb, pinfo, vj_tree);
     return;
   }
 
@@ -540,8 +537,7 @@ vjc_process(tvbuff_t *src_tvb, packet_info *pinfo, proto_tree *tree,
      * non-decompressible.
      */
     col_set_str(pinfo->cinfo, COL_INFO, "VJ compressed TCP (not enough data available)");
-    if(tree != NULL)
-      call_dissector(data_handle, src_tvb, pinfo, tree);
+    call_dissector(data_handle, src_tvb, pinfo, tree);
     if(comp != NULL) {
       for(i = 0; i < TCP_SIMUL_CONV_MAX; i++)
         comp->rstate[i].flags |= SLF_TOSS;
@@ -167,6 +167,7 @@ epan_dissect_init(epan_dissect_t *edt, const gboolean create_proto_tree, const g
 	}
 
 	edt->pi.dependent_frames = NULL;
+	edt->pi.layers = g_array_new(FALSE, FALSE, sizeof(int));
 
 	return edt;
 }
@@ -231,6 +232,11 @@ epan_dissect_cleanup(epan_dissect_t* edt)
 
 	g_slist_free(edt->pi.dependent_frames);
 
+	if (edt->pi.layers) {
+		g_array_free(edt->pi.layers, TRUE);
+		edt->pi.layers = NULL;
+	}
+
 	/* Free the data sources list. */
 	free_data_sources(&edt->pi);
 
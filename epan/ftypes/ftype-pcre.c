@@ -32,6 +32,21 @@
 #include <glib.h>
 #include <string.h>
 
+#include <epan/strutil.h>
+
+/* A compiled pattern.  Every fvalue made from the same pattern string
+ * shares one of these, so that the display filter, the colouring rules
+ * and the taps only compile and study a given "matches" pattern once. */
+struct _fvalue_regex_t {
+    GRegex *re;
+    gchar *pattern;         /* our key in regex_cache */
+    guint refcount;
+    gchar *literal;         /* bytes that any match must contain, or NULL */
+    gsize literal_len;
+};
+
+static GHashTable *regex_cache = NULL;
+
 static void
 gregex_fvalue_new(fvalue_t *fv)
 {
@@ -41,9 +56,17 @@ gregex_fvalue_new(fvalue_t *fv)
 static void
 gregex_fvalue_free(fvalue_t *fv)
 {
-    if (fv->value.re) {
-        g_regex_unref(fv->value.re);
+    fvalue_regex_t *regex = fv->value.re;
+
+    if (regex) {
         fv->value.re = NULL;
+        if (--regex->refcount == 0) {
+            g_hash_table_remove(regex_cache, regex->pattern);
+            g_regex_unref(regex->re);
+            g_free(regex->pattern);
+            g_free(regex->literal);
+            g_free(regex);
+        }
     }
 }
 
@@ -72,6 +95,111 @@ raw_flag_needed(const gchar *pattern)
     return found;
 }
 
+/* Find the longest run of plain characters, outside of any group, that
+ * every match of the pattern has to contain; a substring search for it
+ * rules out most non-matching values far more cheaply than running the
+ * regex itself.  This errs on the side of returning nothing: patterns
+ * with alternatives or inline options don't get a literal at all, and
+ * anything that looks like an escape sequence ends the current run. */
+static gchar *
+required_literal(const gchar *pattern, gsize *literal_len)
+{
+    const gchar *p, *run = NULL, *best = NULL;
+    gsize run_len, best_len = 0;
+    int depth = 0;
+
+    if (strchr(pattern, '|') != NULL || strstr(pattern, "(?") != NULL)
+        return NULL;
+
+    for (p = pattern; ; p++) {
+        if (*p != '\0' && depth == 0 && strchr("\\^$.[]()?*+{}", *p) == NULL) {
+            if (run == NULL)
+                run = p;
+            continue;
+        }
+
+        if (run != NULL) {
+            run_len = p - run;
+            if (*p == '?' || *p == '*' || *p == '{') {
+                /* The quantifier makes the last character optional. */
+                run_len--;
+                while (run_len > 0 && ((guchar)run[run_len] & 0xC0) == 0x80)
+                    run_len--;
+            }
+            if (run_len > best_len) {
+                best = run;
+                best_len = run_len;
+            }
+            run = NULL;
+        }
+
+        switch (*p) {
+        case '\0':
+            if (best == NULL)
+                return NULL;
+            *literal_len = best_len;
+            return g_strndup(best, best_len);
+
+        case '\\':
+            if (p[1] == 'Q')
+                return NULL;
+            if (p[1] != '\0')
+                p++;
+            /* \d, \x41, \p{L}, \g{1}, ...: skip whatever might be an
+               argument rather than mistake it for a literal. */
+            if (g_ascii_isalnum(*p)) {
+                while (p[1] != '\0' &&
+                       (g_ascii_isalnum(p[1]) || strchr("{}<>'", p[1]) != NULL))
+                    p++;
+            }
+            break;
+
+        case '[':
+            p++;
+            if (*p == '^')
+                p++;
+            if (*p == ']')
+                p++;
+            while (*p != ']') {
+                if (*p == '\0')
+                    return NULL;
+                if (*p == '\\' && p[1] != '\0')
+                    p++;
+                p++;
+            }
+            break;
+
+        case '(':
+            depth++;
+            break;
+
+        case ')':
+            if (depth > 0)
+                depth--;
+            break;
+        }
+    }
+}
+
+gboolean
+fvalue_regex_matches(const fvalue_regex_t *regex, const char *data, gsize len)
+{
+    if (regex->literal != NULL &&
+        epan_memmem((const guint8 *)data, (guint)len,
+                    (const guint8 *)regex->literal, (guint)regex->literal_len) == NULL) {
+        return FALSE;
+    }
+    return g_regex_match_full(
+            regex->re,          /* Compiled PCRE */
+            data,               /* The data to check for the pattern... */
+            (gssize)len,        /* ... and its length */
+            0,                  /* Start offset within data */
+            0,                  /* GRegexMatchFlags */
+            NULL,               /* We are not interested in the match information */
+            NULL                /* We don't want error information */
+            );
+}
+
 /* Generate a FT_PCRE from a parsed string pattern.
  * Uses the specified logfunc() to report errors. */
 static gboolean
@@ -79,6 +207,21 @@ val_from_string(fvalue_t *fv, char *pattern, LogFunc logfunc)
 {
     GError *regex_error = NULL;
     GRegexCompileFlags cflags = G_REGEX_OPTIMIZE;
+    GRegex *re;
+    fvalue_regex_t *regex;
+
+    /* Free up the old value, if we have one */
+    gregex_fvalue_free(fv);
+
+    if (regex_cache == NULL)
+        regex_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+    regex = (fvalue_regex_t *)g_hash_table_lookup(regex_cache, pattern);
+    if (regex) {
+        regex->refcount++;
+        fv->value.re = regex;
+        return TRUE;
+    }
 
     /* Set RAW flag only if pattern requires matching raw byte
        sequences. Otherwise, omit it so that GRegex treats its
@@ -87,10 +230,7 @@ val_from_string(fvalue_t *fv, char *pattern, LogFunc logfunc)
         cflags |= G_REGEX_RAW;
     }
 
-    /* Free up the old value, if we have one */
-    gregex_fvalue_free(fv);
-
-    fv->value.re = g_regex_new(
+    re = g_regex_new(
             pattern,            /* pattern */
             cflags,             /* Compile options */
             0,                  /* Match options */
@@ -102,11 +242,20 @@ val_from_string(fvalue_t *fv, char *pattern, LogFunc logfunc)
             logfunc(regex_error->message);
         }
         g_error_free(regex_error);
-        if (fv->value.re) {
-            g_regex_unref(fv->value.re);
+        if (re) {
+            g_regex_unref(re);
         }
         return FALSE;
     }
+
+    regex = g_new(fvalue_regex_t, 1);
+    regex->re = re;
+    regex->pattern = g_strdup(pattern);
+    regex->refcount = 1;
+    regex->literal = required_literal(pattern, &regex->literal_len);
+    g_hash_table_insert(regex_cache, regex->pattern, regex);
+
+    fv->value.re = regex;
     return TRUE;
 }
 
@@ -124,14 +273,14 @@ static int
 gregex_repr_len(fvalue_t *fv, ftrepr_t rtype)
 {
     g_assert(rtype == FTREPR_DFILTER);
-    return (int)strlen(g_regex_get_pattern(fv->value.re));
+    return (int)strlen(fv->value.re->pattern);
 }
 
 static void
 gregex_to_repr(fvalue_t *fv, ftrepr_t rtype, char *buf)
 {
     g_assert(rtype == FTREPR_DFILTER);
-    strcpy(buf, g_regex_get_pattern(fv->value.re));
+    strcpy(buf, fv->value.re->pattern);
 }
 
 /* BEHOLD - value contains the string representation of the regular expression,
@@ -149,7 +298,7 @@ gregex_fvalue_set(fvalue_t *fv, gpointer value, gboolean already_copied)
 static gpointer
 gregex_fvalue_get(fvalue_t *fv)
 {
-    return fv->value.re;
+    return fv->value.re ? fv->value.re->re : NULL;
 }
 
 void
@@ -249,27 +249,19 @@ static gboolean
 cmp_matches(fvalue_t *fv_a, fvalue_t *fv_b)
 {
 	char *str = fv_a->value.string;
-	GRegex *regex = fv_b->value.re;
+	fvalue_regex_t *regex = fv_b->value.re;
 
 	/* fv_b is always a FT_PCRE, otherwise the dfilter semcheck() would have
 	 * warned us. For the same reason (and because we're using g_malloc()),
 	 * fv_b->value.re is not NULL.
 	 */
-	if (strcmp(fv_b->ftype->name, "FT_PCRE") != 0) {
+	if (fv_b->ftype->ftype != FT_PCRE) {
 		return FALSE;
 	}
 	if (! regex) {
 		return FALSE;
 	}
-	return g_regex_match_full(
-			regex,		/* Compiled PCRE */
-			str,		/* The data to check for the pattern... */
-			(int)strlen(str),	/* ... and its length */
-			0,		/* Start offset within data */
-			0,		/* GRegexMatchFlags */
-			NULL,		/* We are not interested in the match information */
-			NULL		/* We don't want error information */
-			);
+	return fvalue_regex_matches(regex, str, strlen(str));
 }
 
 void
@@ -377,7 +377,7 @@ static gboolean
 cmp_matches(fvalue_t *fv_a, fvalue_t *fv_b)
 {
 	tvbuff_t *tvb = fv_a->value.tvb;
-	GRegex *regex = fv_b->value.re;
+	fvalue_regex_t *regex = fv_b->value.re;
 	volatile gboolean rc = FALSE;
 	const char *data = NULL; /* tvb data */
 	guint32 tvb_len; /* tvb length */
@@ -386,7 +386,7 @@ cmp_matches(fvalue_t *fv_a, fvalue_t *fv_b)
 	 * warned us. For the same reason (and because we're using g_malloc()),
 	 * fv_b->value.re is not NULL.
 	 */
-	if (strcmp(fv_b->ftype->name, "FT_PCRE") != 0) {
+	if (fv_b->ftype->ftype != FT_PCRE) {
 		return FALSE;
 	}
 	if (! regex) {
@@ -395,15 +395,7 @@ cmp_matches(fvalue_t *fv_a, fvalue_t *fv_b)
 	TRY {
 		tvb_len = tvb_length(tvb);
 		data = (const char *)tvb_get_ptr(tvb, 0, tvb_len);
-		rc = g_regex_match_full(
-			regex,		/* Compiled PCRE */
-			data,		/* The data to check for the pattern... */
-			tvb_len,	/* ... and its length */
-			0,		/* Start offset within data */
-			0,		/* GRegexMatchFlags */
-			NULL,		/* We are not interested in the match information */
-			NULL		/* We don't want error information */
-			);
+		rc = fvalue_regex_matches(regex, data, tvb_len);
 		/* NOTE - DO NOT g_free(data) */
 	}
 	CATCH_ALL {
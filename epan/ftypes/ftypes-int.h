@@ -46,4 +46,8 @@ void ftype_register_time(void);
 void ftype_register_tvbuff(void);
 void ftype_register_pcre(void);
 
+/* Does the FT_PCRE value match len bytes of data? */
+gboolean
+fvalue_regex_matches(const fvalue_regex_t *regex, const char *data, gsize len);
+
 #endif
@@ -156,6 +156,9 @@ ftype_can_matches(enum ftenum ftype);
 #include <epan/nstime.h>
 #include <epan/dfilter/drange.h>
 
+/* A compiled FT_PCRE pattern; private to ftype-pcre.c */
+typedef struct _fvalue_regex_t fvalue_regex_t;
+
 typedef struct _fvalue_t {
 	ftype_t	*ftype;
 	union {
@@ -172,7 +175,7 @@ typedef struct _fvalue_t {
 		e_guid_t	guid;
 		nstime_t	time;
 		tvbuff_t	*tvb;
-		GRegex	        *re;
+		fvalue_regex_t	*re;
 	} value;
 
 	/* The following is provided for private use
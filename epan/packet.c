@@ -55,6 +55,8 @@
 #include <epan/reassemble.h>
 #include <epan/stream.h>
 #include <epan/expert.h>
+#include <epan/conversation.h>
+#include <epan/prefs.h>
 
 static gint proto_malformed = -1;
 static dissector_handle_t frame_handle = NULL;
@@ -69,12 +71,15 @@ struct data_source {
   char *name;
 };
 
+static void heur_conv_retired(conversation_t *conversation);
+
 void
 packet_init(void)
 {
 	frame_handle = find_dissector("frame");
 	data_handle = find_dissector("data");
 	proto_malformed = proto_get_id_by_filter_name("malformed");
+	register_conversation_retire_routine(heur_conv_retired);
 }
 
 void
@@ -131,6 +136,8 @@ call_init_routine(gpointer routine, gpointer dummy _U_)
  * We should probably split that into "init" and "cleanup" routines, for
  * cleanliness' sake.
  */
+static void heur_conv_cache_init(void);
+
 void
 init_dissection(void)
 {
@@ -147,6 +154,9 @@ init_dissection(void)
 	/* Initialize the table of conversations. */
 	epan_conversation_init();
 
+	/* Forget the heuristic dissectors that matched the old conversations. */
+	heur_conv_cache_init();
+
 	/* Initialize the table of circuits. */
 	epan_circuit_init();
 
@@ -167,6 +177,7 @@ cleanup_dissection(void)
 	 * memory (at least until conversation's use of g_slist is changed).
 	 */
 	epan_conversation_cleanup();
+	heur_conv_cache_init();
 
 	/* Reclaim all memory of seasonal scope */
 	se_free_all();
@@ -314,9 +325,15 @@ void
 dissect_packet(epan_dissect_t *edt, struct wtap_pkthdr *phdr,
 	       const guchar *pd, frame_data *fd, column_info *cinfo)
 {
+	GArray *layers = edt->pi.layers;
+
 	if (cinfo != NULL)
 		col_init(cinfo);
 	memset(&edt->pi, 0, sizeof(edt->pi));
+	/* The array of layers is reused from packet to packet */
+	edt->pi.layers = layers;
+	if (layers != NULL)
+		g_array_set_size(layers, 0);
 	edt->pi.current_proto = "<Missing Protocol Name>";
 	edt->pi.cinfo = cinfo;
 	edt->pi.fd = fd;
@@ -486,6 +503,7 @@ call_dissector_work(dissector_handle_t handle, tvbuff_t *tvb, packet_info *pinfo
 	guint16      saved_can_desegment;
 	int          ret;
 	gint         saved_layer_names_len = 0;
+	guint        saved_layers_len = 0;
 
 	if (handle->protocol != NULL &&
 	    !proto_is_protocol_enabled(handle->protocol)) {
@@ -500,6 +518,8 @@ call_dissector_work(dissector_handle_t handle, tvbuff_t *tvb, packet_info *pinfo
 
 	if (pinfo->layer_names != NULL)
 		saved_layer_names_len = (gint) pinfo->layer_names->len;
+	if (pinfo->layers != NULL)
+		saved_layers_len = pinfo->layers->len;
 
 	/*
 	 * can_desegment is set to 2 by anyone which offers the
@@ -529,6 +549,10 @@ call_dissector_work(dissector_handle_t handle, tvbuff_t *tvb, packet_info *pinfo
 				g_string_append(pinfo->layer_names,
 				proto_get_protocol_filter_name(proto_get_id(handle->protocol)));
 		}
+		if ((pinfo->layers)&&(add_proto_name)) {
+			int proto_id = proto_get_id(handle->protocol);
+			g_array_append_val(pinfo->layers, proto_id);
+		}
 	}
 
 	if (pinfo->flags.in_error_pkt) {
@@ -548,6 +572,9 @@ call_dissector_work(dissector_handle_t handle, tvbuff_t *tvb, packet_info *pinfo
  		if ((pinfo->layer_names != NULL)&&(add_proto_name)) {
  			g_string_truncate(pinfo->layer_names, saved_layer_names_len);
 		}
+		if ((pinfo->layers != NULL)&&(add_proto_name)) {
+			g_array_set_size(pinfo->layers, saved_layers_len);
+		}
  	}
  	pinfo->current_proto = saved_proto;
  	pinfo->can_desegment = saved_can_desegment;
@@ -1638,6 +1665,82 @@ get_dissector_table_base(const char *name)
 
 static GHashTable *heur_dissector_lists = NULL;
 
+/*
+ * For each conversation and heuristic list, the dissector in that list
+ * that last accepted a packet in that conversation.  A conversation only
+ * goes through a list or two, so the cache maps each conversation to a
+ * GSList of these, which can be dropped when the conversation is retired.
+ */
+typedef struct {
+	heur_dissector_list_t  sub_dissectors;
+	heur_dtbl_entry_t     *hdtbl_entry;
+} heur_conv_entry_t;
+
+static GHashTable *heur_conv_cache = NULL;
+
+/* Runs while we're collecting heuristic dissector statistics */
+static GTimer *heur_stats_timer = NULL;
+
+static void
+heur_conv_entries_free(gpointer data)
+{
+	GSList *entry;
+
+	for (entry = (GSList *)data; entry != NULL; entry = g_slist_next(entry))
+		g_free(entry->data);
+	g_slist_free((GSList *)data);
+}
+
+static void
+heur_conv_cache_init(void)
+{
+	if (heur_conv_cache != NULL)
+		g_hash_table_destroy(heur_conv_cache);
+	heur_conv_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	    NULL, heur_conv_entries_free);
+}
+
+static heur_conv_entry_t *
+heur_conv_cache_find(conversation_t *conversation,
+    heur_dissector_list_t sub_dissectors)
+{
+	GSList *entry;
+
+	for (entry = (GSList *)g_hash_table_lookup(heur_conv_cache, conversation);
+	    entry != NULL; entry = g_slist_next(entry)) {
+		if (((heur_conv_entry_t *)entry->data)->sub_dissectors == sub_dissectors)
+			return (heur_conv_entry_t *)entry->data;
+	}
+	return NULL;
+}
+
+static void
+heur_conv_cache_set(conversation_t *conversation,
+    heur_dissector_list_t sub_dissectors, heur_dtbl_entry_t *hdtbl_entry)
+{
+	heur_conv_entry_t *conv_entry;
+	GSList *entries;
+
+	conv_entry = heur_conv_cache_find(conversation, sub_dissectors);
+	if (conv_entry == NULL) {
+		conv_entry = g_new(heur_conv_entry_t, 1);
+		conv_entry->sub_dissectors = sub_dissectors;
+		entries = (GSList *)g_hash_table_lookup(heur_conv_cache, conversation);
+		g_hash_table_steal(heur_conv_cache, conversation);
+		g_hash_table_insert(heur_conv_cache, conversation,
+		    g_slist_prepend(entries, conv_entry));
+	}
+	conv_entry->hdtbl_entry = hdtbl_entry;
+}
+
+/* A conversation has been retired; it won't be found again. */
+static void
+heur_conv_retired(conversation_t *conversation)
+{
+	if (heur_conv_cache != NULL)
+		g_hash_table_remove(heur_conv_cache, conversation);
+}
+
 
 /* Finds a heuristic dissector table by table name. */
 static heur_dissector_list_t *
@@ -1676,6 +1779,9 @@ heur_dissector_add(const char *name, heur_dissector_t dissector, const int proto
 	hdtbl_entry->dissector = dissector;
 	hdtbl_entry->protocol  = find_protocol_by_id(proto);
 	hdtbl_entry->enabled   = TRUE;
+	hdtbl_entry->calls     = 0;
+	hdtbl_entry->accepted  = 0;
+	hdtbl_entry->time_spent = 0.0;
 
 	/* do the table insertion */
 	*sub_dissectors = g_slist_append(*sub_dissectors, (gpointer)hdtbl_entry);
@@ -1710,6 +1816,10 @@ heur_dissector_delete(const char *name, heur_dissector_t dissector, const int pr
 		*sub_dissectors = g_slist_remove_link(*sub_dissectors, found_entry);
 		g_free(g_slist_nth_data(found_entry, 1));
 		g_slist_free_1(found_entry);
+
+		/* The cache may point at the entry, or use the list as a key. */
+		if (heur_conv_cache != NULL)
+			g_hash_table_remove_all(heur_conv_cache);
 	}
 }
 
@@ -1735,6 +1845,90 @@ heur_dissector_set_enabled(const char *name, heur_dissector_t dissector, const i
 	}
 }
 
+void
+heur_dissector_stats_enable(const gboolean enable)
+{
+	if (enable && heur_stats_timer == NULL) {
+		heur_stats_timer = g_timer_new();
+	} else if (!enable && heur_stats_timer != NULL) {
+		g_timer_destroy(heur_stats_timer);
+		heur_stats_timer = NULL;
+	}
+}
+
+#define HEUR_DISSECTOR_IS_ENABLED(hdtbl_entry) \
+	((hdtbl_entry)->protocol == NULL || \
+	 (proto_is_protocol_enabled((hdtbl_entry)->protocol) && (hdtbl_entry)->enabled))
+
+/*
+ * Hand the packet to one heuristic dissector; if it doesn't accept
+ * the packet, undo what we did to pinfo for it.
+ */
+static gboolean
+call_heur_dissector(heur_dtbl_entry_t *hdtbl_entry, tvbuff_t *tvb,
+		    packet_info *pinfo, proto_tree *tree, void *data,
+		    guint16 saved_can_desegment, gint saved_layer_names_len,
+		    guint saved_layers_len)
+{
+	gboolean accepted;
+	gdouble  start_time = 0.0;
+
+	/* XXX - why set this now and above? */
+	pinfo->can_desegment = saved_can_desegment-(saved_can_desegment>0);
+
+	if (hdtbl_entry->protocol != NULL) {
+		pinfo->current_proto =
+			proto_get_protocol_short_name(hdtbl_entry->protocol);
+
+		/*
+		 * Add the protocol name to the layers; we'll remove it
+		 * if the dissector fails.
+		 */
+		if (pinfo->layer_names) {
+			if (pinfo->layer_names->len > 0)
+				g_string_append(pinfo->layer_names, ":");
+				g_string_append(pinfo->layer_names,
+				proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol)));
+		}
+		if (pinfo->layers) {
+			int proto_id = proto_get_id(hdtbl_entry->protocol);
+			g_array_append_val(pinfo->layers, proto_id);
+		}
+	}
+	EP_CHECK_CANARY(("before calling heuristic dissector for protocol: %s",
+			 proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol))));
+	if (heur_stats_timer != NULL)
+		start_time = g_timer_elapsed(heur_stats_timer, NULL);
+	accepted = (*hdtbl_entry->dissector)(tvb, pinfo, tree, data);
+	if (heur_stats_timer != NULL) {
+		hdtbl_entry->calls++;
+		if (accepted)
+			hdtbl_entry->accepted++;
+		hdtbl_entry->time_spent +=
+			g_timer_elapsed(heur_stats_timer, NULL) - start_time;
+	}
+	if (accepted) {
+		EP_CHECK_CANARY(("after heuristic dissector for protocol: %s has accepted and dissected packet",
+				 proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol))));
+	} else {
+		EP_CHECK_CANARY(("after heuristic dissector for protocol: %s has returned false",
+				 proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol))));
+
+		/*
+		 * That dissector didn't accept the packet, so
+		 * remove its protocol's name from the list
+		 * of protocols.
+		 */
+		if (pinfo->layer_names != NULL) {
+			g_string_truncate(pinfo->layer_names, saved_layer_names_len);
+		}
+		if (pinfo->layers != NULL) {
+			g_array_set_size(pinfo->layers, saved_layers_len);
+		}
+	}
+	return accepted;
+}
+
 gboolean
 dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 			packet_info *pinfo, proto_tree *tree, void *data)
@@ -1743,8 +1937,12 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 	const char        *saved_proto;
 	GSList            *entry;
 	heur_dtbl_entry_t *hdtbl_entry;
+	heur_dtbl_entry_t *cached_entry = NULL;
+	heur_conv_entry_t *conv_entry;
+	conversation_t    *conversation;
 	guint16            saved_can_desegment;
 	gint               saved_layer_names_len = 0;
+	guint              saved_layers_len = 0;
 
 	/* can_desegment is set to 2 by anyone which offers this api/service.
 	   then everytime a subdissector is called it is decremented by one.
@@ -1764,54 +1962,49 @@ dissector_try_heuristic(heur_dissector_list_t sub_dissectors, tvbuff_t *tvb,
 
 	if (pinfo->layer_names != NULL)
 		saved_layer_names_len = (gint) pinfo->layer_names->len;
+	if (pinfo->layers != NULL)
+		saved_layers_len = pinfo->layers->len;
 
-	for (entry = sub_dissectors; entry != NULL; entry = g_slist_next(entry)) {
-		/* XXX - why set this now and above? */
-		pinfo->can_desegment = saved_can_desegment-(saved_can_desegment>0);
+	/*
+	 * If a dissector in this list has already recognized a packet in
+	 * this conversation, it's very likely to recognize this one, so
+	 * try it first rather than running all the dissectors ahead of
+	 * it in the list over every packet.
+	 */
+	conversation = NULL;
+	if (prefs.heur_try_conversation_first && heur_conv_cache != NULL) {
+		conversation = find_conversation(pinfo->fd->num, &pinfo->src,
+		    &pinfo->dst, pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+		if (conversation != NULL) {
+			conv_entry = heur_conv_cache_find(conversation, sub_dissectors);
+			if (conv_entry != NULL)
+				cached_entry = conv_entry->hdtbl_entry;
+			if (cached_entry != NULL && HEUR_DISSECTOR_IS_ENABLED(cached_entry) &&
+			    call_heur_dissector(cached_entry, tvb, pinfo, tree, data,
+						saved_can_desegment, saved_layer_names_len,
+						saved_layers_len)) {
+				status = TRUE;
+			}
+		}
+	}
+
+	for (entry = sub_dissectors; !status && entry != NULL; entry = g_slist_next(entry)) {
 		hdtbl_entry = (heur_dtbl_entry_t *)entry->data;
 
-		if (hdtbl_entry->protocol != NULL &&
-		    (!proto_is_protocol_enabled(hdtbl_entry->protocol)||(hdtbl_entry->enabled==FALSE))) {
+		if (hdtbl_entry == cached_entry || !HEUR_DISSECTOR_IS_ENABLED(hdtbl_entry)) {
 			/*
-			 * No - don't try this dissector.
+			 * No - don't try this dissector (again).
 			 */
 			continue;
 		}
 
-		if (hdtbl_entry->protocol != NULL) {
-			pinfo->current_proto =
-				proto_get_protocol_short_name(hdtbl_entry->protocol);
-
-			/*
-			 * Add the protocol name to the layers; we'll remove it
-			 * if the dissector fails.
-			 */
-			if (pinfo->layer_names) {
-				if (pinfo->layer_names->len > 0)
-					g_string_append(pinfo->layer_names, ":");
-					g_string_append(pinfo->layer_names,
-					proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol)));
-			}
-		}
-		EP_CHECK_CANARY(("before calling heuristic dissector for protocol: %s",
-				 proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol))));
-		if ((*hdtbl_entry->dissector)(tvb, pinfo, tree, data)) {
-			EP_CHECK_CANARY(("after heuristic dissector for protocol: %s has accepted and dissected packet",
-					 proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol))));
+		if (call_heur_dissector(hdtbl_entry, tvb, pinfo, tree, data,
+					saved_can_desegment, saved_layer_names_len,
+					saved_layers_len)) {
 			status = TRUE;
-			break;
-		} else {
-			EP_CHECK_CANARY(("after heuristic dissector for protocol: %s has returned false",
-					 proto_get_protocol_filter_name(proto_get_id(hdtbl_entry->protocol))));
-
-			/*
-			 * That dissector didn't accept the packet, so
-			 * remove its protocol's name from the list
-			 * of protocols.
-			 */
-			if (pinfo->layer_names != NULL) {
-				g_string_truncate(pinfo->layer_names, saved_layer_names_len);
-			}
+			if (conversation != NULL)
+				heur_conv_cache_set(conversation, sub_dissectors,
+				    hdtbl_entry);
 		}
 	}
 	pinfo->current_proto = saved_proto;
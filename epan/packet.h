@@ -246,6 +246,10 @@ typedef struct {
 	heur_dissector_t dissector;
 	protocol_t *protocol;
 	gboolean enabled;
+	/* Only counted while heur_dissector_stats_enable() is in effect */
+	guint32 calls;		/* times the dissector was called */
+	guint32 accepted;	/* times it accepted the packet */
+	gdouble time_spent;	/* seconds spent in the dissector */
 } heur_dtbl_entry_t;
 
 /** A protocol uses this function to register a heuristic sub-dissector list.
@@ -264,6 +268,10 @@ extern void dissector_all_heur_tables_foreach_table (DATFunc_heur_table func,
  *  until we find one that recognizes the protocol.
  *  Call this while the parent dissector running.
  *
+ *  If the "protocols.heur_try_conversation_first" preference is set, the
+ *  dissector that last recognized a packet in the same conversation is
+ *  tried before the others.
+ *
  * @param sub_dissectors the sub-dissector list
  * @param tvb the tv_buff with the (remaining) packet data
  * @param pinfo the packet info of this packet (additional info)
@@ -303,6 +311,14 @@ extern void heur_dissector_delete(const char *name, heur_dissector_t dissector,
  */
 extern void heur_dissector_set_enabled(const char *name, heur_dissector_t dissector, const int proto, const gboolean enabled);
 
+/** Start or stop counting, for each heuristic sub-dissector, how often it
+ *  is called, how often it accepts a packet and how much time it takes.
+ *  Counting costs two clock reads per call, so it's off by default.
+ *
+ * @param enable TRUE to start counting, FALSE to stop
+ */
+extern void heur_dissector_stats_enable(const gboolean enable);
+
 /* Register a dissector. */
 extern void register_dissector(const char *name, dissector_t dissector,
     const int proto);
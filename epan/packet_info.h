@@ -184,6 +184,8 @@ typedef struct _packet_info {
   GHashTable *private_table;	/**< a hash table passed from one dissector to another */
   /* TODO: Use emem_strbuf_t instead */
   GString *layer_names; 		/**< layers of each protocol */
+  GArray *layers;			/**< protocol ids (ints) of the layers dissected so far,
+								 * in order; always recorded, unlike layer_names */
   guint16 link_number;
   guint8  annex_a_used;			/**< used in packet-mtp2.c 
 								 * defined in wtap.h
@@ -2137,6 +2137,12 @@ prefs_register_modules(void)
                                    "Display all hidden protocol items in the packet list.",
                                    &prefs.display_hidden_proto_items);
 
+    prefs_register_bool_preference(protocols_module, "heur_try_conversation_first",
+                                   "Try the last matching heuristic dissector first",
+                                   "Try the heuristic dissector that last recognized a packet "
+                                   "in a conversation before the other heuristic dissectors.",
+                                   &prefs.heur_try_conversation_first);
+
     /* Obsolete preferences
      * These "modules" were reorganized/renamed to correspond to their GUI
      * configuration screen within the preferences dialog
@@ -2656,6 +2662,7 @@ pre_init_prefs(void)
   prefs.rtp_player_max_visible = RTP_PLAYER_DEFAULT_VISIBLE;
 
   prefs.display_hidden_proto_items = FALSE;
+  prefs.heur_try_conversation_first = FALSE;
 
   prefs_pre_initialized = TRUE;
 }
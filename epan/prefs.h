@@ -178,6 +178,7 @@ typedef struct _e_prefs {
   guint    rtp_player_max_visible;
   guint    tap_update_interval;
   gboolean display_hidden_proto_items;
+  gboolean heur_try_conversation_first;
   gpointer filter_expressions;	/* Actually points to &head */
 } e_prefs;
 
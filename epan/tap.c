@@ -36,6 +36,7 @@
 
 #include <string.h>
 #include <epan/packet_info.h>
+#include "epan_dissect.h"
 #include <epan/dfilter/dfilter.h>
 #include <epan/tap.h>
 
@@ -70,6 +71,8 @@ typedef struct _tap_listener_t {
 	gboolean needs_redraw;
 	guint flags;
 	dfilter_t *code;
+	int *fields;		/* fields read by the packet callback */
+	guint num_fields;
 	void *tapdata;
 	tap_reset_cb reset;
 	tap_packet_cb packet;
@@ -77,6 +80,11 @@ typedef struct _tap_listener_t {
 } tap_listener_t;
 static volatile tap_listener_t *tap_listener_queue=NULL;
 
+/* The fields that any tap listener filters on or reads, each only once.
+   Rebuilt before the next packet whenever a listener or filter changes. */
+static GArray *tap_interesting_fields=NULL;
+static gboolean tap_interesting_fields_valid=FALSE;
+
 /* **********************************************************************
  * Init routine only called from epan at application startup
  * ********************************************************************** */
@@ -191,21 +199,65 @@ tap_queue_packet(int tap_id, packet_info *pinfo, const void *tap_specific_data)
  * Functions used by file.c to drive the tap subsystem
  * ********************************************************************** */
 
-void tap_build_interesting (epan_dissect_t *edt)
+static void
+tap_add_interesting_fields(GHashTable *seen, const int *fields, int num_fields)
+{
+	int i;
+
+	for(i=0;i<num_fields;i++){
+		if(g_hash_table_lookup(seen, GINT_TO_POINTER(fields[i]))){
+			continue;
+		}
+		g_hash_table_insert(seen, GINT_TO_POINTER(fields[i]), GINT_TO_POINTER(1));
+		g_array_append_val(tap_interesting_fields, fields[i]);
+	}
+}
+
+/* Collect the fields used by the filters of all tap listeners, and the
+   fields they read, so that each is primed only once per packet however
+   many listeners want it. */
+static void
+tap_update_interesting_fields(void)
 {
 	tap_listener_t *tl;
+	GHashTable *seen;
+	const int *fields;
+	int num_fields;
 
-	/* nothing to do, just return */
-	if(!tap_listener_queue){
-		return;
+	if(tap_interesting_fields){
+		g_array_set_size(tap_interesting_fields, 0);
+	} else {
+		tap_interesting_fields=g_array_new(FALSE, FALSE, sizeof(int));
 	}
 
-	/* loop over all tap listeners and build the list of all
-	   interesting hf_fields */
+	seen=g_hash_table_new(g_direct_hash, g_direct_equal);
 	for(tl=(tap_listener_t *)tap_listener_queue;tl;tl=tl->next){
 		if(tl->code){
-			epan_dissect_prime_dfilter(edt, tl->code);
+			fields=dfilter_interesting_fields(tl->code, &num_fields);
+			tap_add_interesting_fields(seen, fields, num_fields);
 		}
+		tap_add_interesting_fields(seen, tl->fields, tl->num_fields);
+	}
+	g_hash_table_destroy(seen);
+
+	tap_interesting_fields_valid=TRUE;
+}
+
+void tap_build_interesting (epan_dissect_t *edt)
+{
+	guint i;
+
+	/* nothing to do, just return */
+	if(!tap_listener_queue){
+		return;
+	}
+
+	if(!tap_interesting_fields_valid){
+		tap_update_interesting_fields();
+	}
+
+	for(i=0;i<tap_interesting_fields->len;i++){
+		proto_tree_prime_hfid(edt->tree, g_array_index(tap_interesting_fields, int, i));
 	}
 }
 
@@ -401,6 +453,8 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 
 	tl=g_malloc(sizeof(tap_listener_t));
 	tl->code=NULL;
+	tl->fields=NULL;
+	tl->num_fields=0;
 	tl->needs_redraw=TRUE;
 	tl->flags=flags;
 	if(fstring){
@@ -422,6 +476,7 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 	tl->next=(tap_listener_t *)tap_listener_queue;
 
 	tap_listener_queue=tl;
+	tap_interesting_fields_valid=FALSE;
 
 	return NULL;
 }
@@ -456,6 +511,7 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 			tl->code=NULL;
 		}
 		tl->needs_redraw=TRUE;
+		tap_interesting_fields_valid=FALSE;
 		if(fstring){
 			if(!dfilter_compile(fstring, &tl->code)){
 				error_string = g_string_new("");
@@ -470,6 +526,35 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 	return NULL;
 }
 
+/* this function declares the fields that the packet callback of a tap
+ * listener reads from the protocol tree.  They are primed along with the
+ * fields of the filters, so the listener gets them from a tree in which
+ * everything else is faked, and needn't ask for TL_REQUIRES_PROTO_TREE.
+ */
+void
+set_tap_listener_fields(void *tapdata, const int *hfids, guint num_hfids)
+{
+	tap_listener_t *tl;
+
+	for(tl=(tap_listener_t *)tap_listener_queue;tl;tl=tl->next){
+		if(tl->tapdata==tapdata){
+			break;
+		}
+	}
+	if(!tl){
+		return;
+	}
+
+	g_free(tl->fields);
+	tl->fields=NULL;
+	tl->num_fields=0;
+	if(num_hfids){
+		tl->fields=g_memdup(hfids, num_hfids*sizeof(int));
+		tl->num_fields=num_hfids;
+	}
+	tap_interesting_fields_valid=FALSE;
+}
+
 /* this function removes a tap listener
  */
 void
@@ -499,7 +584,9 @@ remove_tap_listener(void *tapdata)
 		if(tl->code){
 			dfilter_free(tl->code);
 		}
+		g_free(tl->fields);
 		g_free(tl);
+		tap_interesting_fields_valid=FALSE;
 	}
 
 	return;
@@ -542,7 +629,9 @@ have_tap_listener(int tap_id)
 }
 
 /*
- * Return TRUE if we have any tap listeners with filters, FALSE otherwise.
+ * Return TRUE if we have any tap listeners with filters or that read
+ * fields, i.e. that need a protocol tree with some fields primed, FALSE
+ * otherwise.
  */
 gboolean
 have_filtering_tap_listeners(void)
@@ -550,7 +639,7 @@ have_filtering_tap_listeners(void)
 	tap_listener_t *tl;
 
 	for(tl=(tap_listener_t *)tap_listener_queue;tl;tl=tl->next){
-		if(tl->code)
+		if(tl->code || tl->num_fields)
 			return TRUE;
 	}
 	return FALSE;
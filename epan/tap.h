@@ -58,6 +58,7 @@ extern GString *register_tap_listener(const char *tapname, void *tapdata,
     const char *fstring, guint flags, tap_reset_cb tap_reset,
     tap_packet_cb tap_packet, tap_draw_cb tap_draw);
 extern GString *set_tap_dfilter(void *tapdata, const char *fstring);
+extern void set_tap_listener_fields(void *tapdata, const int *hfids, guint num_hfids);
 extern void remove_tap_listener(void *tapdata);
 extern gboolean tap_listeners_require_dissection(void);
 extern gboolean have_tap_listener(int tap_id);
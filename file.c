@@ -91,7 +91,7 @@ static void cf_reset_state(capture_file *cf);
 static int read_packet(capture_file *cf, dfilter_t *dfcode,
     epan_dissect_t *edt, column_info *cinfo, gint64 offset);
 
-static void rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect);
+static void rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect, gboolean narrowed);
 
 typedef enum {
   MR_NOTMATCHED,
@@ -322,6 +322,7 @@ cf_open(capture_file *cf, const char *fname, gboolean is_tempfile, int *err)
   cf->ref_time_count = 0;
   cf->drops_known = FALSE;
   cf->drops     = 0;
+  cf->dfilter_applied = TRUE;
   cf->snap      = wtap_snapshot_length(cf->wth);
   if (cf->snap == 0) {
     /* Snapshot length not known. */
@@ -1179,6 +1180,17 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
   return row;
 }
 
+/* Account for a frame we know won't pass the display filter, without
+   reading or dissecting it. */
+static void
+skip_packet_in_packet_list(frame_data *fdata, capture_file *cf)
+{
+  frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                &first_ts, prev_dis, prev_cap);
+  prev_cap = fdata;
+  fdata->flags.passed_dfilter = 0;
+}
+
 /* read in a new packet */
 /* returns the row of the new packet in the packet list or -1 if not displayed */
 static int
@@ -1610,6 +1622,8 @@ cf_filter_packets(capture_file *cf, gchar *dftext, gboolean force)
   const char *filter_new = dftext ? dftext : "";
   const char *filter_old = cf->dfilter ? cf->dfilter : "";
   dfilter_t  *dfcode;
+  dfilter_t  *old_dfcode;
+  gboolean    narrowed = FALSE;
   GTimeVal    start_time;
 
   /* if new filter equals old one, do nothing unless told to do so */
@@ -1647,6 +1661,16 @@ cf_filter_packets(capture_file *cf, gchar *dftext, gboolean force)
     }
   }
 
+  /* If the new filter is the old one with more terms "and"ed to it, only
+     the frames that passed the old one can pass it, so we needn't look at
+     the others - unless a tap wants to see every frame. */
+  if (!force && dfcode != NULL && cf->dfilter != NULL && cf->dfilter_applied &&
+      !tap_listeners_require_dissection() &&
+      dfilter_compile(cf->dfilter, &old_dfcode)) {
+    narrowed = dfilter_narrows(dfcode, old_dfcode);
+    dfilter_free(old_dfcode);
+  }
+
   /* We have a valid filter.  Replace the current filter. */
   g_free(cf->dfilter);
   cf->dfilter = dftext;
@@ -1656,9 +1680,9 @@ cf_filter_packets(capture_file *cf, gchar *dftext, gboolean force)
   /* Now rescan the packet list, applying the new filter, but not
      throwing away information constructed on a previous pass. */
   if (dftext == NULL) {
-    rescan_packets(cf, "Resetting", "Filter", FALSE);
+    rescan_packets(cf, "Resetting", "Filter", FALSE, FALSE);
   } else {
-    rescan_packets(cf, "Filtering", dftext, FALSE);
+    rescan_packets(cf, "Filtering", dftext, FALSE, narrowed);
   }
 
   /* Cleanup and release all dfilter resources */
@@ -1676,7 +1700,7 @@ cf_reftime_packets(capture_file *cf)
 void
 cf_redissect_packets(capture_file *cf)
 {
-  rescan_packets(cf, "Reprocessing", "all packets", TRUE);
+  rescan_packets(cf, "Reprocessing", "all packets", TRUE, FALSE);
 }
 
 gboolean
@@ -1749,9 +1773,13 @@ cf_read_frame(capture_file *cf, frame_data *fdata)
    "redissect" is TRUE if we need to make the dissectors reconstruct
    any state information they have (because a preference that affects
    some dissector has changed, meaning some dissector might construct
-   its state differently from the way it was constructed the last time). */
+   its state differently from the way it was constructed the last time).
+
+   "narrowed" is TRUE if the display filter only accepts frames that the
+   previous one accepted, in which case we only need to look at the frames
+   that are currently displayed. */
 static void
-rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect)
+rescan_packets(capture_file *cf, const char *action, const char *action_item, gboolean redissect, gboolean narrowed)
 {
   /* Rescan packets new packet list */
   guint32     framenum;
@@ -1932,9 +1960,6 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     /* Frame dependencies from the previous dissection/filtering are no longer valid. */
     fdata->flags.dependent_of_displayed = 0;
 
-    if (!cf_read_frame(cf, fdata))
-      break; /* error reading the frame */
-
     /* If the previous frame is displayed, and we haven't yet seen the
        selected frame, remember that frame - it's the closest one we've
        yet seen before the selected frame. */
@@ -1942,9 +1967,18 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       preceding_frame_num = prev_frame_num;
       preceding_frame = prev_frame;
     }
-    add_packet_to_packet_list(fdata, cf, dfcode, &edt,
-                                    cinfo, &cf->phdr, cf->pd,
-                                    add_to_packet_list);
+
+    if (narrowed && !fdata->flags.passed_dfilter && !fdata->flags.ref_time) {
+      /* It didn't pass the previous filter, so it can't pass this one. */
+      skip_packet_in_packet_list(fdata, cf);
+    } else {
+      if (!cf_read_frame(cf, fdata))
+        break; /* error reading the frame */
+
+      add_packet_to_packet_list(fdata, cf, dfcode, &edt,
+                                      cinfo, &cf->phdr, cf->pd,
+                                      add_to_packet_list);
+    }
 
     /* If this frame is displayed, and this is the first frame we've
        seen displayed after the selected frame, remember this frame -
@@ -1967,6 +2001,10 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   }
   epan_dissect_finish(&edt);
 
+  /* If we stopped early, the frames we didn't get to still have the
+     verdicts of an older filter. */
+  cf->dfilter_applied = (framenum > frames_count);
+
   /* We are done redissecting the packet list. */
   cf->redissecting = FALSE;
 
@@ -3162,6 +3200,57 @@ cf_find_packet_data(capture_file *cf, const guint8 *string, size_t string_size,
     return find_packet(cf, match_binary, &info, dir);
 }
 
+/*
+ * Finds the places in the packet data where a search string might start,
+ * i.e. where its first character occurs (in either case, if we're ignoring
+ * case).  memchr() is usually vectorized by the C library, so this skips
+ * through the data much faster than looking at each byte ourselves.
+ */
+typedef struct {
+  const guint8 *end;
+  guint8        c[2];     /* the character, and its lower case form */
+  const guint8 *next[2];  /* where each was found next, or NULL */
+  int           n_chars;  /* 2 if we look for both forms, 1 otherwise */
+} char_scan_t;
+
+#define FOLD_CASE(cf, c) ((cf)->case_type ? (guint8)toupper(c) : (guint8)(c))
+
+static const guint8 *
+char_scan_find(const guint8 *buf, const guint8 *end, guint8 c)
+{
+  if (buf >= end)
+    return NULL;
+  return (const guint8 *)memchr(buf, c, end - buf);
+}
+
+static void
+char_scan_init(char_scan_t *scan, capture_file *cf, const guint8 *end, guint8 c)
+{
+  scan->end = end;
+  scan->c[0] = c;
+  scan->c[1] = cf->case_type ? (guint8)tolower(c) : c;
+  scan->n_chars = (scan->c[1] != c) ? 2 : 1;
+  scan->next[0] = char_scan_find(cf->pd, end, scan->c[0]);
+  scan->next[1] = (scan->n_chars == 2) ? char_scan_find(cf->pd, end, scan->c[1]) : NULL;
+}
+
+/* Return the first possible start at or after buf, or NULL if none. */
+static const guint8 *
+char_scan_next(char_scan_t *scan, const guint8 *buf)
+{
+  int i;
+
+  for (i = 0; i < scan->n_chars; i++) {
+    if (scan->next[i] != NULL && scan->next[i] < buf)
+      scan->next[i] = char_scan_find(buf, scan->end, scan->c[i]);
+  }
+  if (scan->next[1] == NULL)
+    return scan->next[0];
+  if (scan->next[0] == NULL || scan->next[1] < scan->next[0])
+    return scan->next[1];
+  return scan->next[0];
+}
+
 static match_result
 match_ascii_and_unicode(capture_file *cf, frame_data *fdata, void *criterion)
 {
@@ -3169,10 +3258,11 @@ match_ascii_and_unicode(capture_file *cf, frame_data *fdata, void *criterion)
   const guint8 *ascii_text = info->data;
   size_t        textlen    = info->data_len;
   match_result  result;
-  guint32       buf_len;
-  guint32       i;
+  const guint8 *end;
+  const guint8 *start, *p;
+  char_scan_t   scan;
   guint8        c_char;
-  size_t        c_match    = 0;
+  size_t        c_match;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3181,29 +3271,35 @@ match_ascii_and_unicode(capture_file *cf, frame_data *fdata, void *criterion)
   }
 
   result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  i = 0;
-  while (i < buf_len) {
-    c_char = cf->pd[i];
-    if (cf->case_type)
-      c_char = toupper(c_char);
-    if (c_char != '\0') {
-      if (c_char == ascii_text[c_match]) {
-        c_match += 1;
-        if (c_match == textlen) {
-          result = MR_MATCHED;
-          cf->search_pos = i; /* Save the position of the last character
-                                 for highlighting the field. */
-          break;
-        }
-      }
-      else {
-        g_assert(i>=c_match);
-        i -= (guint32)c_match;
-        c_match = 0;
-      }
+  if (textlen == 0)
+    return result;
+  end = cf->pd + fdata->cap_len;
+
+  /* NUL bytes in the packet are skipped, so that we find both ASCII and
+     UTF-16 strings. */
+  char_scan_init(&scan, cf, end, ascii_text[0]);
+  for (start = char_scan_next(&scan, cf->pd); start != NULL;
+       start = char_scan_next(&scan, start + 1)) {
+    c_match = 0;
+    for (p = start; p < end; p++) {
+      c_char = FOLD_CASE(cf, *p);
+      if (c_char == '\0')
+        continue;
+      if (c_char != ascii_text[c_match])
+        break;
+      if (++c_match == textlen)
+        break;
+    }
+    if (c_match == textlen) {
+      result = MR_MATCHED;
+      cf->search_pos = (guint32)(p - cf->pd); /* Save the position of the last character
+                                                  for highlighting the field. */
+      break;
+    }
+    if (p == end) {
+      /* We ran out of data; so will every later start. */
+      break;
     }
-    i += 1;
   }
   return result;
 }
@@ -3216,9 +3312,9 @@ match_ascii(capture_file *cf, frame_data *fdata, void *criterion)
   size_t        textlen    = info->data_len;
   match_result  result;
   guint32       buf_len;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
+  const guint8 *start;
+  char_scan_t   scan;
+  size_t        c_match;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3228,26 +3324,22 @@ match_ascii(capture_file *cf, frame_data *fdata, void *criterion)
 
   result = MR_NOTMATCHED;
   buf_len = fdata->cap_len;
-  i = 0;
-  while (i < buf_len) {
-    c_char = cf->pd[i];
-    if (cf->case_type)
-      c_char = toupper(c_char);
-    if (c_char == ascii_text[c_match]) {
-      c_match += 1;
-      if (c_match == textlen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
+  if (textlen == 0 || textlen > buf_len)
+    return result;
+
+  char_scan_init(&scan, cf, cf->pd + buf_len - textlen + 1, ascii_text[0]);
+  for (start = char_scan_next(&scan, cf->pd); start != NULL;
+       start = char_scan_next(&scan, start + 1)) {
+    for (c_match = 0; c_match < textlen; c_match++) {
+      if (FOLD_CASE(cf, start[c_match]) != ascii_text[c_match])
         break;
-      }
     }
-    else {
-      g_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
+    if (c_match == textlen) {
+      result = MR_MATCHED;
+      cf->search_pos = (guint32)(start - cf->pd + textlen - 1); /* Save the position of the last character
+                                                                    for highlighting the field. */
+      break;
     }
-    i += 1;
   }
 
   return result;
@@ -3261,9 +3353,9 @@ match_unicode(capture_file *cf, frame_data *fdata, void *criterion)
   size_t        textlen    = info->data_len;
   match_result  result;
   guint32       buf_len;
-  guint32       i;
-  guint8        c_char;
-  size_t        c_match    = 0;
+  const guint8 *start;
+  char_scan_t   scan;
+  size_t        c_match;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3273,27 +3365,23 @@ match_unicode(capture_file *cf, frame_data *fdata, void *criterion)
 
   result = MR_NOTMATCHED;
   buf_len = fdata->cap_len;
-  i = 0;
-  while (i < buf_len) {
-    c_char = cf->pd[i];
-    if (cf->case_type)
-      c_char = toupper(c_char);
-    if (c_char == ascii_text[c_match]) {
-      c_match += 1;
-      if (c_match == textlen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
+  if (textlen == 0 || (textlen - 1) * 2 >= buf_len)
+    return result;
+
+  /* The characters of the string are every other byte of the packet. */
+  char_scan_init(&scan, cf, cf->pd + buf_len - (textlen - 1) * 2, ascii_text[0]);
+  for (start = char_scan_next(&scan, cf->pd); start != NULL;
+       start = char_scan_next(&scan, start + 1)) {
+    for (c_match = 0; c_match < textlen; c_match++) {
+      if (FOLD_CASE(cf, start[c_match * 2]) != ascii_text[c_match])
         break;
-      }
-      i += 1;
     }
-    else {
-      g_assert(i>=(c_match*2));
-      i -= (guint32)c_match*2;
-      c_match = 0;
+    if (c_match == textlen) {
+      result = MR_MATCHED;
+      cf->search_pos = (guint32)(start - cf->pd + (textlen - 1) * 2); /* Save the position of the last character
+                                                                          for highlighting the field. */
+      break;
     }
-    i += 1;
   }
   return result;
 }
@@ -3305,9 +3393,7 @@ match_binary(capture_file *cf, frame_data *fdata, void *criterion)
   const guint8 *binary_data = info->data;
   size_t        datalen     = info->data_len;
   match_result  result;
-  guint32       buf_len;
-  guint32       i;
-  size_t        c_match     = 0;
+  const guint8 *found;
 
   /* Load the frame's data. */
   if (!cf_read_frame(cf, fdata)) {
@@ -3316,24 +3402,11 @@ match_binary(capture_file *cf, frame_data *fdata, void *criterion)
   }
 
   result = MR_NOTMATCHED;
-  buf_len = fdata->cap_len;
-  i = 0;
-  while (i < buf_len) {
-    if (cf->pd[i] == binary_data[c_match]) {
-      c_match += 1;
-      if (c_match == datalen) {
-        result = MR_MATCHED;
-        cf->search_pos = i; /* Save the position of the last character
-                               for highlighting the field. */
-        break;
-      }
-    }
-    else {
-      g_assert(i>=c_match);
-      i -= (guint32)c_match;
-      c_match = 0;
-    }
-    i += 1;
+  found = epan_memmem(cf->pd, fdata->cap_len, binary_data, (guint)datalen);
+  if (found != NULL) {
+    result = MR_MATCHED;
+    cf->search_pos = (guint32)(found - cf->pd + datalen - 1); /* Save the position of the last character
+                                                                  for highlighting the field. */
   }
   return result;
 }
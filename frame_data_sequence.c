@@ -250,10 +250,8 @@ free_frame_data_sequence(frame_data_sequence *fds)
   guint i, j, k;
 
   if (fds->count == 0) {
-    /* Nothing to free. */
-    return;
-  }
-  if (fds->count <= NODES_PER_LEVEL) {
+    /* Nothing to free but the sequence itself. */
+  } else if (fds->count <= NODES_PER_LEVEL) {
     /* It's a 1-level tree. */
     g_free(fds->ptree_root);
   } else if (fds->count <= NODES_PER_LEVEL*NODES_PER_LEVEL) {
@@ -267,12 +265,11 @@ free_frame_data_sequence(frame_data_sequence *fds)
     level2 = fds->ptree_root;
     for (i = 0; i < NODES_PER_LEVEL && level2[i] != NULL; i++) {
       level1 = level2[i];
-      for (j = 0; j < NODES_PER_LEVEL && level1[i] != NULL; j++)
+      for (j = 0; j < NODES_PER_LEVEL && level1[j] != NULL; j++)
         g_free(level1[j]);
       g_free(level1);
     }
     g_free(level2);
-    return;
   } else {
     /* fds->count is 2^32-1 at most, and NODES_PER_LEVEL^4
        2^(LOG2_NODES_PER_LEVEL*4), and LOG2_NODES_PER_LEVEL is 10,
@@ -281,10 +278,11 @@ free_frame_data_sequence(frame_data_sequence *fds)
     level3 = fds->ptree_root;
     for (i = 0; i < NODES_PER_LEVEL && level3[i] != NULL; i++) {
       level2 = level3[i];
-      for (j = 0; j < NODES_PER_LEVEL && level2[i] != NULL; j++) {
+      for (j = 0; j < NODES_PER_LEVEL && level2[j] != NULL; j++) {
         level1 = level2[j];
         for (k = 0; k < NODES_PER_LEVEL && level1[k] != NULL; k++)
           g_free(level1[k]);
+        g_free(level1);
       }
       g_free(level2);
     }
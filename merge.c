@@ -26,6 +26,18 @@
 #include "wtap.h"
 #include "merge.h"
 
+/*
+ * The input files that have a packet ready, kept as a binary min-heap
+ * ordered by the time stamp of that packet, so that merge_read_packet()
+ * doesn't have to look at every input file for every packet it returns.
+ */
+struct merge_heap_s {
+  merge_in_file_t **files;
+  int               count;
+  gboolean          primed;  /* have we read the first packet of every file? */
+  merge_in_file_t  *pending; /* file whose packet we returned last */
+};
+
 /*
  * Scan through the arguments and open the input files
  */
@@ -39,6 +51,8 @@ merge_open_in_files(int in_file_count, char *const *in_file_names,
   merge_in_file_t *files;
   gint64 size;
 
+  struct merge_heap_s *heap;
+
   files = (merge_in_file_t *)g_malloc(files_size);
   *in_files = files;
 
@@ -48,6 +62,7 @@ merge_open_in_files(int in_file_count, char *const *in_file_names,
     files[i].data_offset = 0;
     files[i].state       = PACKET_NOT_PRESENT;
     files[i].packet_num  = 0;
+    files[i].heap        = NULL;
     if (!files[i].wth) {
       /* Close the files we've already opened. */
       for (j = 0; j < i; j++)
@@ -64,6 +79,14 @@ merge_open_in_files(int in_file_count, char *const *in_file_names,
     }
     files[i].size = size;
   }
+
+  heap = g_new(struct merge_heap_s, 1);
+  heap->files   = g_new(merge_in_file_t *, in_file_count);
+  heap->count   = 0;
+  heap->primed  = FALSE;
+  heap->pending = NULL;
+  for (i = 0; i < in_file_count; i++)
+    files[i].heap = heap;
   return TRUE;
 }
 
@@ -77,6 +100,12 @@ merge_close_in_files(int count, merge_in_file_t in_files[])
   for (i = 0; i < count; i++) {
     wtap_close(in_files[i].wth);
   }
+  if (count > 0 && in_files[0].heap != NULL) {
+    g_free(in_files[0].heap->files);
+    g_free(in_files[0].heap);
+    for (i = 0; i < count; i++)
+      in_files[i].heap = NULL;
+  }
 }
 
 /*
@@ -129,20 +158,73 @@ merge_max_snapshot_length(int count, merge_in_file_t in_files[])
 }
 
 /*
- * returns TRUE if first argument is earlier than second
+ * returns TRUE if the packet in the first file should be written before
+ * the one in the second file.  Ties go to the file later on the command
+ * line, as they always have.
  */
 static gboolean
-is_earlier(struct wtap_nstime *l, struct wtap_nstime *r) {
-  if (l->secs > r->secs) {  /* left is later */
-    return FALSE;
-  } else if (l->secs < r->secs) { /* left is earlier */
-    return TRUE;
-  } else if (l->nsecs > r->nsecs) { /* tv_sec equal, l.usec later */
-    return FALSE;
+merge_heap_before(merge_in_file_t *l, merge_in_file_t *r) {
+  struct wtap_nstime *lts = &wtap_phdr(l->wth)->ts;
+  struct wtap_nstime *rts = &wtap_phdr(r->wth)->ts;
+
+  if (lts->secs != rts->secs)
+    return lts->secs < rts->secs;
+  if (lts->nsecs != rts->nsecs)
+    return lts->nsecs < rts->nsecs;
+  return l > r;
+}
+
+static void
+merge_heap_sift_up(struct merge_heap_s *heap, int pos)
+{
+  merge_in_file_t *file = heap->files[pos];
+  int parent;
+
+  while (pos > 0) {
+    parent = (pos - 1) / 2;
+    if (!merge_heap_before(file, heap->files[parent]))
+      break;
+    heap->files[pos] = heap->files[parent];
+    pos = parent;
   }
-  /* either one < two or one == two
-   * either way, return one
-   */
+  heap->files[pos] = file;
+}
+
+static void
+merge_heap_sift_down(struct merge_heap_s *heap, int pos)
+{
+  merge_in_file_t *file = heap->files[pos];
+  int child;
+
+  for (;;) {
+    child = 2 * pos + 1;
+    if (child >= heap->count)
+      break;
+    if (child + 1 < heap->count &&
+        merge_heap_before(heap->files[child + 1], heap->files[child]))
+      child++;
+    if (!merge_heap_before(heap->files[child], file))
+      break;
+    heap->files[pos] = heap->files[child];
+    pos = child;
+  }
+  heap->files[pos] = file;
+}
+
+/*
+ * Read the next packet from a file; returns FALSE on a read error.
+ */
+static gboolean
+merge_read_next(merge_in_file_t *in_file, int *err, gchar **err_info)
+{
+  if (!wtap_read(in_file->wth, err, err_info, &in_file->data_offset)) {
+    if (*err != 0) {
+      in_file->state = GOT_ERROR;
+      return FALSE;
+    }
+    in_file->state = AT_EOF;
+  } else
+    in_file->state = PACKET_PRESENT;
   return TRUE;
 }
 
@@ -163,59 +245,70 @@ merge_in_file_t *
 merge_read_packet(int in_file_count, merge_in_file_t in_files[],
                   int *err, gchar **err_info)
 {
+  struct merge_heap_s *heap;
+  merge_in_file_t *in_file;
   int i;
-  int ei = -1;
-  struct wtap_nstime tv = { sizeof(time_t) > sizeof(int) ? LONG_MAX : INT_MAX, INT_MAX };
-  struct wtap_pkthdr *phdr;
 
-  /*
-   * Make sure we have a packet available from each file, if there are any
-   * packets left in the file in question, and search for the packet
-   * with the earliest time stamp.
-   */
-  for (i = 0; i < in_file_count; i++) {
-    if (in_files[i].state == PACKET_NOT_PRESENT) {
-      /*
-       * No packet available, and we haven't seen an error or EOF yet,
-       * so try to read the next packet.
-       */
-      if (!wtap_read(in_files[i].wth, err, err_info, &in_files[i].data_offset)) {
-        if (*err != 0) {
-          in_files[i].state = GOT_ERROR;
-          return &in_files[i];
-        }
-        in_files[i].state = AT_EOF;
-      } else
-        in_files[i].state = PACKET_PRESENT;
-    }
-    
-    if (in_files[i].state == PACKET_PRESENT) {
-      phdr = wtap_phdr(in_files[i].wth);
-      if (is_earlier(&phdr->ts, &tv)) {
-        tv = phdr->ts;
-        ei = i;
+  if (in_file_count == 0) {
+    *err = 0;
+    return NULL;
+  }
+  heap = in_files[0].heap;
+
+  if (!heap->primed) {
+    /*
+     * Get the first packet of every file, and put the files that have
+     * one on the heap.
+     */
+    for (i = 0; i < in_file_count; i++) {
+      if (in_files[i].state != PACKET_NOT_PRESENT)
+        continue;
+      if (!merge_read_next(&in_files[i], err, err_info))
+        return &in_files[i];
+      if (in_files[i].state == PACKET_PRESENT) {
+        heap->files[heap->count++] = &in_files[i];
+        merge_heap_sift_up(heap, heap->count - 1);
       }
     }
+    heap->primed = TRUE;
+  } else if (heap->pending != NULL) {
+    /*
+     * We handed out the packet at the top of the heap last time; replace
+     * it with the next packet from the same file, or drop the file from
+     * the heap if it has no more packets.
+     */
+    in_file = heap->pending;
+    if (!merge_read_next(in_file, err, err_info))
+      return in_file;
+    heap->pending = NULL;
+    if (in_file->state != PACKET_PRESENT) {
+      heap->files[0] = heap->files[--heap->count];
+    }
+    if (heap->count > 0)
+      merge_heap_sift_down(heap, 0);
   }
 
-  if (ei == -1) {
+  if (heap->count == 0) {
     /* All the streams are at EOF.  Return an EOF indication. */
     *err = 0;
     return NULL;
   }
 
+  in_file = heap->files[0];
+
   /* We'll need to read another packet from this file. */
-  in_files[ei].state = PACKET_NOT_PRESENT;
+  in_file->state = PACKET_NOT_PRESENT;
+  heap->pending = in_file;
 
   /* Count this packet. */
-  in_files[ei].packet_num++;
+  in_file->packet_num++;
 
   /*
    * Return a pointer to the merge_in_file_t of the file from which the
    * packet was read.
    */
   *err = 0;
-  return &in_files[ei];
+  return in_file;
 }
 
 /*
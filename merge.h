@@ -36,6 +36,8 @@ typedef enum {
   GOT_ERROR
 } in_file_state_e;
 
+struct merge_heap_s;
+
 /**
  * Structures to manage our input files.
  */
@@ -48,6 +50,7 @@ typedef struct merge_in_file_s {
   gint64          size;		      /* file size */
   guint32         interface_id;   /* identifier of the interface. 
 								   * Used for fake interfaces when writing WTAP_ENCAP_PER_PACKET */
+  struct merge_heap_s *heap;      /* shared by all the input files; used by merge_read_packet() */
 } merge_in_file_t;
 
 /** Open a number of input files to merge.
@@ -193,15 +193,40 @@ struct option {
         } while (0);                                                                       \
 }
 
+/*
+ * Size of the buffer we give each file we write to.  Packets are written
+ * one at a time, so with the default stdio buffer (typically one file
+ * system block) we'd make a write() call every few packets; with this,
+ * packets accumulate until dumpcap flushes the file (at least every
+ * DUMPCAP_UPD_TIME when capturing to a file) or the buffer fills, and
+ * go out in a few large writes.
+ */
+#define PCAPIO_BUFFER_SIZE (1024 * 1024)
+
+/* The buffers handed to setvbuf(), keyed by FILE *, so that we can free
+   them once the file's been closed. */
+static GHashTable *file_buffers = NULL;
+
 /* Returns a FILE * to write to on success, NULL on failure */
 FILE *
 libpcap_fdopen(int fd, int *err)
 {
         FILE *fp;
+        char *buf;
 
         fp = fdopen(fd, "wb");
         if (fp == NULL) {
                 *err = errno;
+                return NULL;
+        }
+        buf = (char *)g_malloc(PCAPIO_BUFFER_SIZE);
+        if (setvbuf(fp, buf, _IOFBF, PCAPIO_BUFFER_SIZE) == 0) {
+                if (file_buffers == NULL)
+                        file_buffers = g_hash_table_new(g_direct_hash, g_direct_equal);
+                g_hash_table_insert(file_buffers, fp, buf);
+        } else {
+                /* Just use whatever buffering stdio gave us. */
+                g_free(buf);
         }
         return fp;
 }
@@ -560,7 +585,8 @@ libpcap_write_enhanced_packet_block(FILE *fp,
         struct epb epb;
         guint32 block_total_length;
         guint64 timestamp;
-        const guint32 padding = 0;
+        guint32 trailer[2];
+        guint padding_length;
 
         block_total_length = sizeof(struct epb) +
                              ADD_PADDING(phdr->caplen) +
@@ -576,10 +602,13 @@ libpcap_write_enhanced_packet_block(FILE *fp,
         epb.packet_len = phdr->len;
         WRITE_DATA(fp, &epb, sizeof(struct epb), *bytes_written, err);
         WRITE_DATA(fp, pd, phdr->caplen, *bytes_written, err);
-        if (phdr->caplen % 4) {
-                WRITE_DATA(fp, &padding, 4 - phdr->caplen % 4, *bytes_written, err);
-        }
-        WRITE_DATA(fp, &block_total_length, sizeof(guint32), *bytes_written, err);
+        /* Write the padding and the trailing Block Total Length together,
+           to save a trip through stdio for every packet. */
+        padding_length = ADD_PADDING(phdr->caplen) - phdr->caplen;
+        trailer[0] = 0;
+        trailer[1] = block_total_length;
+        WRITE_DATA(fp, (guint8 *)trailer + sizeof(guint32) - padding_length,
+                   padding_length + sizeof(guint32), *bytes_written, err);
         return TRUE;
 }
 
@@ -750,7 +779,17 @@ libpcap_dump_flush(FILE *pd, int *err)
 gboolean
 libpcap_dump_close(FILE *pd, int *err)
 {
-        if (fclose(pd) == EOF) {
+        int ret;
+        char *buf = NULL;
+
+        if (file_buffers != NULL) {
+                buf = (char *)g_hash_table_lookup(file_buffers, pd);
+                g_hash_table_remove(file_buffers, pd);
+        }
+        ret = fclose(pd);
+        /* The buffer must outlive the FILE, as fclose() flushes it. */
+        g_free(buf);
+        if (ret == EOF) {
                 if (err != NULL)
                         *err = errno;
                 return FALSE;
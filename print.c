@@ -65,7 +65,7 @@ typedef struct {
 
 typedef struct {
 	int			level;
-	FILE			*fh;
+	GString			*buf;
 	GSList		 	*src_list;
 	epan_dissect_t		*edt;
 } write_pdml_data;
@@ -82,7 +82,10 @@ struct _output_fields {
     gchar aggregator;
     GPtrArray* fields;
     GHashTable* field_indicies;
-    emem_strbuf_t** field_values;
+    header_field_info** field_hfinfos;  /* NULL if no such field */
+    GString** field_values;             /* reused from packet to packet */
+    gboolean primed;                    /* only our fields are in the tree */
+    gboolean shared_names;              /* some field's name has several hfids */
     gchar quote;
 };
 
@@ -99,9 +102,9 @@ static gboolean print_hex_data_buffer(print_stream_t *stream, const guchar *cp,
     guint length, packet_char_enc encoding);
 static void ps_clean_string(unsigned char *out, const unsigned char *in,
 			int outbuf_size);
-static void print_escaped_xml(FILE *fh, const char *unescaped_string);
+static void print_escaped_xml(GString *buf, const char *unescaped_string);
 
-static void print_pdml_geninfo(proto_tree *tree, FILE *fh);
+static void print_pdml_geninfo(proto_tree *tree, GString *buf);
 
 static void proto_tree_get_node_field_values(proto_node *node, gpointer data);
 
@@ -249,6 +252,116 @@ void proto_tree_print_node(proto_node *node, gpointer data)
 	}
 }
 
+/*
+ * The export formats put each packet together in this buffer and write
+ * it out in one go, rather than making a stdio call for every element
+ * and attribute.  It's kept from packet to packet.
+ */
+static GString *output_buf = NULL;
+
+/* What to write instead of each byte of a string; empty if the byte
+ * can be written as it is. */
+#define ESCAPE_LEN 8
+static gchar xml_escapes[256][ESCAPE_LEN];
+static gchar csv_escapes[256][ESCAPE_LEN];
+
+static void
+init_escapes(void)
+{
+	int c;
+
+	for (c = 1; c < 256; c++) {
+		if (g_ascii_isprint(c))
+			xml_escapes[c][0] = '\0';
+		else
+			g_snprintf(xml_escapes[c], ESCAPE_LEN, "\\x%x", c);
+
+		if (c < ' ' || c >= 0177)
+			g_snprintf(csv_escapes[c], ESCAPE_LEN, "\\%03o", c);
+		else
+			csv_escapes[c][0] = '\0';
+	}
+
+	g_strlcpy(xml_escapes['&'], "&amp;", ESCAPE_LEN);
+	g_strlcpy(xml_escapes['<'], "&lt;", ESCAPE_LEN);
+	g_strlcpy(xml_escapes['>'], "&gt;", ESCAPE_LEN);
+	g_strlcpy(xml_escapes['"'], "&quot;", ESCAPE_LEN);
+	g_strlcpy(xml_escapes['\''], "&apos;", ESCAPE_LEN);
+
+	g_strlcpy(csv_escapes['\b'], "\\b", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['\f'], "\\f", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['\n'], "\\n", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['\r'], "\\r", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['\t'], "\\t", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['\v'], "\\v", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['\\'], "\\\\", ESCAPE_LEN);
+	g_strlcpy(csv_escapes['"'], "\"\"", ESCAPE_LEN);
+}
+
+static GString *
+output_buf_start(void)
+{
+	if (output_buf == NULL) {
+		output_buf = g_string_sized_new(65536);
+		init_escapes();
+	} else {
+		g_string_truncate(output_buf, 0);
+	}
+	return output_buf;
+}
+
+static void
+output_buf_write(GString *buf, FILE *fh)
+{
+	fwrite(buf->str, 1, buf->len, fh);
+}
+
+/* Append a string, copying runs of bytes that needn't be escaped as they are */
+static void
+append_escaped(GString *buf, const char *str, gchar (*escapes)[ESCAPE_LEN])
+{
+	const guchar *p, *run;
+
+	for (p = run = (const guchar *)str; *p != '\0'; p++) {
+		if (escapes[*p][0] != '\0') {
+			g_string_append_len(buf, (const gchar *)run, p - run);
+			g_string_append(buf, escapes[*p]);
+			run = p + 1;
+		}
+	}
+	g_string_append_len(buf, (const gchar *)run, p - run);
+}
+
+static void
+append_hex(GString *buf, const guint8 *pd, int len)
+{
+	static const gchar hex[] = "0123456789abcdef";
+	gsize pos = buf->len;
+	int i;
+
+	g_string_set_size(buf, pos + 2 * len);
+	for (i = 0; i < len; i++) {
+		buf->str[pos++] = hex[pd[i] >> 4];
+		buf->str[pos++] = hex[pd[i] & 0x0f];
+	}
+}
+
+static void
+append_int(GString *buf, gint val)
+{
+	gchar digits[12];
+	int i = sizeof digits;
+	guint uval = val < 0 ? -(guint)val : (guint)val;
+
+	do {
+		digits[--i] = '0' + uval % 10;
+		uval /= 10;
+	} while (uval != 0);
+	if (val < 0)
+		digits[--i] = '-';
+	g_string_append_len(buf, &digits[i], sizeof digits - i);
+}
+
 #define PDML2HTML_XSL "pdml2html.xsl"
 void
 write_pdml_preamble(FILE *fh, const gchar* filename)
@@ -271,19 +384,20 @@ proto_tree_write_pdml(epan_dissect_t *edt, FILE *fh)
 
 	/* Create the output */
 	data.level = 0;
-	data.fh = fh;
+	data.buf = output_buf_start();
 	data.src_list = edt->pi.data_src;
 	data.edt = edt;
 
-	fprintf(fh, "<packet>\n");
+	g_string_append(data.buf, "<packet>\n");
 
 	/* Print a "geninfo" protocol as required by PDML */
-	print_pdml_geninfo(edt->tree, fh);
+	print_pdml_geninfo(edt->tree, data.buf);
 
 	proto_tree_children_foreach(edt->tree, proto_tree_write_node_pdml,
 	    &data);
 
-	fprintf(fh, "</packet>\n\n");
+	g_string_append(data.buf, "</packet>\n\n");
+	output_buf_write(data.buf, fh);
 }
 
 /* Write out a tree's data, and any child nodes, as PDML */
@@ -311,17 +425,17 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 
 	/* Indent to the correct level */
 	for (i = -1; i < pdata->level; i++) {
-		fputs("  ", pdata->fh);
+		g_string_append(pdata->buf, "  ");
 	}
 
 	if (wrap_in_fake_protocol) {
 		/* Open fake protocol wrapper */
-		fputs("<proto name=\"fake-field-wrapper\">\n", pdata->fh);
+		g_string_append(pdata->buf, "<proto name=\"fake-field-wrapper\">\n");
 
 		/* Indent to increased level before writing out field */
 		pdata->level++;
 		for (i = -1; i < pdata->level; i++) {
-			fputs("  ", pdata->fh);
+			g_string_append(pdata->buf, "  ");
 		}
 	}
 
@@ -336,25 +450,27 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 		}
 
 		/* Show empty name since it is a required field */
-		fputs("<field name=\"", pdata->fh);
-		fputs("\" show=\"", pdata->fh);
-		print_escaped_xml(pdata->fh, label_ptr);
+		g_string_append(pdata->buf, "<field name=\"\" show=\"");
+		print_escaped_xml(pdata->buf, label_ptr);
 
-		fprintf(pdata->fh, "\" size=\"%d", fi->length);
+		g_string_append(pdata->buf, "\" size=\"");
+		append_int(pdata->buf, fi->length);
 		if (node->parent && node->parent->finfo && (fi->start < node->parent->finfo->start)) {
-			fprintf(pdata->fh, "\" pos=\"%d", node->parent->finfo->start + fi->start);
+			g_string_append(pdata->buf, "\" pos=\"");
+			append_int(pdata->buf, node->parent->finfo->start + fi->start);
 		} else {
-			fprintf(pdata->fh, "\" pos=\"%d", fi->start);
+			g_string_append(pdata->buf, "\" pos=\"");
+			append_int(pdata->buf, fi->start);
 		}
 
-		fputs("\" value=\"", pdata->fh);
+		g_string_append(pdata->buf, "\" value=\"");
 		write_pdml_field_hex_value(pdata, fi);
 
 		if (node->first_child != NULL) {
-			fputs("\">\n", pdata->fh);
+			g_string_append(pdata->buf, "\">\n");
 		}
 		else {
-			fputs("\"/>\n", pdata->fh);
+			g_string_append(pdata->buf, "\"/>\n");
 		}
 	}
 
@@ -363,19 +479,19 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 	else if (fi->hfinfo->id == proto_data) {
 
 		/* Write out field with data */
-		fputs("<field name=\"data\" value=\"", pdata->fh);
+		g_string_append(pdata->buf, "<field name=\"data\" value=\"");
 		write_pdml_field_hex_value(pdata, fi);
-		fputs("\">\n", pdata->fh);
+		g_string_append(pdata->buf, "\">\n");
 	}
 	/* Normal protocols and fields */
 	else {
 		if (fi->hfinfo->type == FT_PROTOCOL && fi->hfinfo->id != proto_expert) {
-			fputs("<proto name=\"", pdata->fh);
+			g_string_append(pdata->buf, "<proto name=\"");
 		}
 		else {
-			fputs("<field name=\"", pdata->fh);
+			g_string_append(pdata->buf, "<field name=\"");
 		}
-		print_escaped_xml(pdata->fh, fi->hfinfo->abbrev);
+		print_escaped_xml(pdata->buf, fi->hfinfo->abbrev);
 
 #if 0
 	/* PDML spec, see:
@@ -391,31 +507,34 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 	 * (like it's contained in the fi->rep->representation).
 	 * Unfortunately, we don't have the field data representation for
 	 * all fields, so this isn't currently possible */
-		fputs("\" showname=\"", pdata->fh);
-		print_escaped_xml(pdata->fh, fi->hfinfo->name);
+		g_string_append(pdata->buf, "\" showname=\"");
+		print_escaped_xml(pdata->buf, fi->hfinfo->name);
 #endif
 
 		if (fi->rep) {
-			fputs("\" showname=\"", pdata->fh);
-			print_escaped_xml(pdata->fh, fi->rep->representation);
+			g_string_append(pdata->buf, "\" showname=\"");
+			print_escaped_xml(pdata->buf, fi->rep->representation);
 		}
 		else {
 			label_ptr = label_str;
 			proto_item_fill_label(fi, label_str);
-			fputs("\" showname=\"", pdata->fh);
-			print_escaped_xml(pdata->fh, label_ptr);
+			g_string_append(pdata->buf, "\" showname=\"");
+			print_escaped_xml(pdata->buf, label_ptr);
 		}
 
 		if (PROTO_ITEM_IS_HIDDEN(node))
-			fprintf(pdata->fh, "\" hide=\"yes");
+			g_string_append(pdata->buf, "\" hide=\"yes");
 
-		fprintf(pdata->fh, "\" size=\"%d", fi->length);
+		g_string_append(pdata->buf, "\" size=\"");
+		append_int(pdata->buf, fi->length);
 		if (node->parent && node->parent->finfo && (fi->start < node->parent->finfo->start)) {
-			fprintf(pdata->fh, "\" pos=\"%d", node->parent->finfo->start + fi->start);
+			g_string_append(pdata->buf, "\" pos=\"");
+			append_int(pdata->buf, node->parent->finfo->start + fi->start);
 		} else {
-			fprintf(pdata->fh, "\" pos=\"%d", fi->start);
+			g_string_append(pdata->buf, "\" pos=\"");
+			append_int(pdata->buf, fi->start);
 		}
-/*		fprintf(pdata->fh, "\" id=\"%d", fi->hfinfo->id);*/
+/*		g_string_append_printf(pdata->buf, "\" id=\"%d", fi->hfinfo->id);*/
 
 		/* show, value, and unmaskedvalue attributes */
 		switch (fi->hfinfo->type)
@@ -423,7 +542,7 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 		case FT_PROTOCOL:
 			break;
 		case FT_NONE:
-			fputs("\" show=\"\" value=\"",  pdata->fh);
+			g_string_append(pdata->buf, "\" show=\"\" value=\"");
 			break;
 		default:
 			/* XXX - this is a hack until we can just call
@@ -443,8 +562,8 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 					chop_len++;
 				}
 
-				fputs("\" show=\"", pdata->fh);
-				print_escaped_xml(pdata->fh, &dfilter_string[chop_len]);
+				g_string_append(pdata->buf, "\" show=\"");
+				print_escaped_xml(pdata->buf, &dfilter_string[chop_len]);
 			}
 
 			/*
@@ -455,11 +574,11 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 			 * they might be generated fields.
 			 */
 			if (fi->length > 0) {
-				fputs("\" value=\"", pdata->fh);
+				g_string_append(pdata->buf, "\" value=\"");
 
 				if (fi->hfinfo->bitmask!=0) {
-					fprintf(pdata->fh, "%X", fvalue_get_uinteger(&fi->value));
-					fputs("\" unmaskedvalue=\"", pdata->fh);
+					g_string_append_printf(pdata->buf, "%X", fvalue_get_uinteger(&fi->value));
+					g_string_append(pdata->buf, "\" unmaskedvalue=\"");
 					write_pdml_field_hex_value(pdata, fi);
 				}
 				else {
@@ -469,13 +588,13 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 		}
 
 		if (node->first_child != NULL) {
-			fputs("\">\n", pdata->fh);
+			g_string_append(pdata->buf, "\">\n");
 		}
 		else if (fi->hfinfo->id == proto_data) {
-			fputs("\">\n", pdata->fh);
+			g_string_append(pdata->buf, "\">\n");
 		}
 		else {
-			fputs("\"/>\n", pdata->fh);
+			g_string_append(pdata->buf, "\"/>\n");
 		}
 	}
 
@@ -495,25 +614,25 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
 	if (node->first_child != NULL) {
 		/* Indent to correct level */
 		for (i = -1; i < pdata->level; i++) {
-			fputs("  ", pdata->fh);
+			g_string_append(pdata->buf, "  ");
 		}
 		/* Close off current element */
 		/* Data and expert "protocols" use simple tags */
 		if (fi->hfinfo->id != proto_data && fi->hfinfo->id != proto_expert) {
 			if (fi->hfinfo->type == FT_PROTOCOL) {
-				fputs("</proto>\n", pdata->fh);
+				g_string_append(pdata->buf, "</proto>\n");
 			}
 			else {
-				fputs("</field>\n", pdata->fh);
+				g_string_append(pdata->buf, "</field>\n");
 			}
 		} else {
-			fputs("</field>\n", pdata->fh);
+			g_string_append(pdata->buf, "</field>\n");
 		}
 	}
 
 	/* Close off fake wrapper protocol */
 	if (wrap_in_fake_protocol) {
-		fputs("</proto>\n", pdata->fh);
+		g_string_append(pdata->buf, "</proto>\n");
 	}
 }
 
@@ -522,7 +641,7 @@ proto_tree_write_node_pdml(proto_node *node, gpointer data)
  * but we produce a 'geninfo' protocol in the PDML to conform to spec.
  * The 'frame' protocol follows the 'geninfo' protocol in the PDML. */
 static void
-print_pdml_geninfo(proto_tree *tree, FILE *fh)
+print_pdml_geninfo(proto_tree *tree, GString *buf)
 {
 	guint32 num, len, caplen;
 	nstime_t *timestamp;
@@ -570,32 +689,32 @@ print_pdml_geninfo(proto_tree *tree, FILE *fh)
 	g_ptr_array_free(finfo_array, TRUE);
 
 	/* Print geninfo start */
-	fprintf(fh,
+	g_string_append_printf(buf,
 "  <proto name=\"geninfo\" pos=\"0\" showname=\"General information\" size=\"%u\">\n",
 		frame_finfo->length);
 
 	/* Print geninfo.num */
-	fprintf(fh,
+	g_string_append_printf(buf,
 "    <field name=\"num\" pos=\"0\" show=\"%u\" showname=\"Number\" value=\"%x\" size=\"%u\"/>\n",
 		num, num, frame_finfo->length);
 
 	/* Print geninfo.len */
-	fprintf(fh,
+	g_string_append_printf(buf,
 "    <field name=\"len\" pos=\"0\" show=\"%u\" showname=\"Frame Length\" value=\"%x\" size=\"%u\"/>\n",
 		len, len, frame_finfo->length);
 
 	/* Print geninfo.caplen */
-	fprintf(fh,
+	g_string_append_printf(buf,
 "    <field name=\"caplen\" pos=\"0\" show=\"%u\" showname=\"Captured Length\" value=\"%x\" size=\"%u\"/>\n",
 		caplen, caplen, frame_finfo->length);
 
 	/* Print geninfo.timestamp */
-	fprintf(fh,
+	g_string_append_printf(buf,
 "    <field name=\"timestamp\" pos=\"0\" show=\"%s\" showname=\"Captured Time\" value=\"%d.%09d\" size=\"%u\"/>\n",
 		abs_time_to_str(timestamp, ABSOLUTE_TIME_LOCAL, TRUE), (int) timestamp->secs, timestamp->nsecs, frame_finfo->length);
 
 	/* Print geninfo end */
-	fprintf(fh,
+	g_string_append(buf,
 "  </proto>\n");
 }
 
@@ -619,30 +738,33 @@ proto_tree_write_psml(epan_dissect_t *edt, FILE *fh)
 {
 	gint	i;
 
+	GString	*buf = output_buf_start();
+
 	/* if this is the first packet, we have to create the PSML structure output */
 	if(write_headers) {
-	    fprintf(fh, "<structure>\n");
+	    g_string_append(buf, "<structure>\n");
 
 	    for(i=0; i < edt->pi.cinfo->num_cols; i++) {
-		fprintf(fh, "<section>");
-		print_escaped_xml(fh, edt->pi.cinfo->col_title[i]);
-		fprintf(fh, "</section>\n");
+		g_string_append(buf, "<section>");
+		print_escaped_xml(buf, edt->pi.cinfo->col_title[i]);
+		g_string_append(buf, "</section>\n");
 	    }
 
-	    fprintf(fh, "</structure>\n\n");
+	    g_string_append(buf, "</structure>\n\n");
 
 	    write_headers = FALSE;
 	}
 
-	fprintf(fh, "<packet>\n");
+	g_string_append(buf, "<packet>\n");
 
 	for(i=0; i < edt->pi.cinfo->num_cols; i++) {
-	    fprintf(fh, "<section>");
-	    print_escaped_xml(fh, edt->pi.cinfo->col_data[i]);
-	    fprintf(fh, "</section>\n");
+	    g_string_append(buf, "<section>");
+	    print_escaped_xml(buf, edt->pi.cinfo->col_data[i]);
+	    g_string_append(buf, "</section>\n");
 	}
 
-	fprintf(fh, "</packet>\n\n");
+	g_string_append(buf, "</packet>\n\n");
+	output_buf_write(buf, fh);
 }
 
 void
@@ -657,43 +779,34 @@ write_csv_preamble(FILE *fh _U_)
 	write_headers = TRUE;
 }
 
-static gchar *csv_massage_str(const gchar *source, const gchar *exceptions)
-{
-    gchar *csv_str;
-    gchar *tmp_str;
-
-    csv_str = g_strescape(source, exceptions);
-    tmp_str = csv_str;
-    while ( (tmp_str = strstr(tmp_str, "\\\"")) != NULL )
-        *tmp_str = '\"';
-    return csv_str;
-}
-
-static void csv_write_str(const char *str, char sep, FILE *fh)
+/* Escaped the way g_strescape() does it, except that a double quote is
+ * doubled rather than backslashed. */
+static void csv_write_str(const char *str, char sep, GString *buf)
 {
-    gchar *csv_str;
-
-    csv_str = csv_massage_str(str, NULL);
-    fprintf(fh, "\"%s\"%c", csv_str, sep);
-    g_free(csv_str);
+    g_string_append_c(buf, '"');
+    append_escaped(buf, str, csv_escapes);
+    g_string_append_c(buf, '"');
+    g_string_append_c(buf, sep);
 }
 
 void
 proto_tree_write_csv(epan_dissect_t *edt, FILE *fh)
 {
     gint i;
+    GString *buf = output_buf_start();
 
     /* if this is the first packet, we have to write the CSV header */
     if(write_headers) {
         for(i=0; i < edt->pi.cinfo->num_cols - 1; i++)
-            csv_write_str(edt->pi.cinfo->col_title[i], ',', fh);
-        csv_write_str(edt->pi.cinfo->col_title[i], '\n', fh);
+            csv_write_str(edt->pi.cinfo->col_title[i], ',', buf);
+        csv_write_str(edt->pi.cinfo->col_title[i], '\n', buf);
         write_headers = FALSE;
     }
 
     for(i=0; i < edt->pi.cinfo->num_cols - 1; i++)
-        csv_write_str(edt->pi.cinfo->col_data[i], ',', fh);
-    csv_write_str(edt->pi.cinfo->col_data[i], '\n', fh);
+        csv_write_str(edt->pi.cinfo->col_data[i], ',', buf);
+    csv_write_str(edt->pi.cinfo->col_data[i], '\n', buf);
+    output_buf_write(buf, fh);
 }
 
 void
@@ -819,50 +932,21 @@ get_field_data(GSList *src_list, field_info *fi)
 /* Print a string, escaping out certain characters that need to
  * escaped out for XML. */
 static void
-print_escaped_xml(FILE *fh, const char *unescaped_string)
+print_escaped_xml(GString *buf, const char *unescaped_string)
 {
-	const char *p;
-	char temp_str[8];
-
-	for (p = unescaped_string; *p != '\0'; p++) {
-		switch (*p) {
-			case '&':
-				fputs("&amp;", fh);
-				break;
-			case '<':
-				fputs("&lt;", fh);
-				break;
-			case '>':
-				fputs("&gt;", fh);
-				break;
-			case '"':
-				fputs("&quot;", fh);
-				break;
-			case '\'':
-				fputs("&apos;", fh);
-				break;
-			default:
-				if (g_ascii_isprint(*p))
-					fputc(*p, fh);
-				else {
-					g_snprintf(temp_str, sizeof(temp_str), "\\x%x", (guint8)*p);
-					fputs(temp_str, fh);
-				}
-		}
-	}
+	append_escaped(buf, unescaped_string, xml_escapes);
 }
 
 static void
 write_pdml_field_hex_value(write_pdml_data *pdata, field_info *fi)
 {
-	int i;
 	const guint8 *pd;
 
 	if (!fi->ds_tvb)
 		return;
 
 	if (fi->length > tvb_length_remaining(fi->ds_tvb, fi->start)) {
-		fprintf(pdata->fh, "field length invalid!");
+		g_string_append(pdata->buf, "field length invalid!");
 		return;
 	}
 
@@ -871,9 +955,7 @@ write_pdml_field_hex_value(write_pdml_data *pdata, field_info *fi)
 
 	if (pd) {
 		/* Print a simple hex dump */
-		for (i = 0 ; i < fi->length; i++) {
-			fprintf(pdata->fh, "%02x", pd[i]);
-		}
+		append_hex(pdata->buf, pd, fi->length);
 	}
 }
 
@@ -1349,7 +1431,10 @@ output_fields_t* output_fields_new(void)
     fields->aggregator = ',';
     fields->fields = NULL; /*Do lazy initialisation */
     fields->field_indicies = NULL;
+    fields->field_hfinfos = NULL;
     fields->field_values = NULL;
+    fields->primed = FALSE;
+    fields->shared_names = FALSE;
     fields->quote='\0';
     return fields;
 }
@@ -1375,6 +1460,14 @@ void output_fields_free(output_fields_t* fields)
          */
         g_hash_table_destroy(fields->field_indicies);
     }
+    if(NULL != fields->field_values) {
+        gsize i;
+        for(i = 0; i < fields->fields->len; ++i) {
+            g_string_free(fields->field_values[i], TRUE);
+        }
+        g_free(fields->field_values);
+        g_free(fields->field_hfinfos);
+    }
     if(NULL != fields->fields) {
         gsize i;
         for(i = 0; i < fields->fields->len; ++i) {
@@ -1544,6 +1637,103 @@ void write_fields_preamble(output_fields_t* fields, FILE *fh)
     fputc('\n', fh);
 }
 
+/* Set up the lookup tables and buffers, once the fields are known. */
+static void output_fields_prepare(output_fields_t* fields)
+{
+    gsize i;
+
+    if(NULL != fields->field_indicies) {
+        return;
+    }
+
+    /* Prepare a lookup table from string abbreviation for field to its index. */
+    fields->field_indicies = g_hash_table_new(g_str_hash, g_str_equal);
+    fields->field_hfinfos = g_new(header_field_info*, fields->fields->len);
+    fields->field_values = g_new(GString*, fields->fields->len);
+
+    i = 0;
+    while( i < fields->fields->len) {
+        gchar* field = (gchar *)g_ptr_array_index(fields->fields, i);
+
+        fields->field_hfinfos[i] = proto_registrar_get_byname(field);
+        if(fields->field_hfinfos[i] && fields->field_hfinfos[i]->same_name_prev) {
+            fields->shared_names = TRUE;
+        }
+        fields->field_values[i] = g_string_new("");
+         /* Store field indicies +1 so that zero is not a valid value,
+          * and can be distinguished from NULL as a pointer.
+          */
+        ++i;
+        g_hash_table_insert(fields->field_indicies, field, GUINT_TO_POINTER(i));
+    }
+}
+
+/*
+ * Can the fields be written from an invisible protocol tree in which
+ * only they have been primed?  That tree is much cheaper to build, but
+ * it has no labels, which text items and protocols are printed from.
+ */
+gboolean output_fields_can_prime(output_fields_t* fields)
+{
+    header_field_info* hfinfo;
+    gsize i;
+
+    g_assert(fields);
+
+    output_fields_prepare(fields);
+
+    for(i = 0; i < fields->fields->len; ++i) {
+        for(hfinfo = fields->field_hfinfos[i]; hfinfo; hfinfo = hfinfo->same_name_prev) {
+            if(hfinfo->id == hf_text_only || hfinfo->type == FT_PROTOCOL) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Prime an epan_dissect_t with the fields, so that they are put in its
+ * protocol tree and can be looked up there without walking it.
+ */
+void output_fields_prime_edt(output_fields_t* fields, epan_dissect_t *edt)
+{
+    header_field_info* hfinfo;
+    gsize i;
+
+    g_assert(fields);
+    g_assert(edt);
+
+    output_fields_prepare(fields);
+
+    for(i = 0; i < fields->fields->len; ++i) {
+        for(hfinfo = fields->field_hfinfos[i]; hfinfo; hfinfo = hfinfo->same_name_prev) {
+            proto_tree_prime_hfid(edt->tree, hfinfo->id);
+        }
+    }
+    fields->primed = TRUE;
+}
+
+static void output_fields_add_value(output_fields_t* fields, guint idx, const gchar* value)
+{
+    GString* buf = fields->field_values[idx];
+
+    if(NULL == value || '\0' == *value) {
+        return;
+    }
+
+    if(0 == buf->len) {
+        g_string_append(buf, value);
+    } else if(fields->occurrence == 'l') {
+        /* print only the value of the last occurrence of the field */
+        g_string_assign(buf, value);
+    } else if(fields->occurrence == 'a') {
+        /* print the value of all accurrences of the field */
+        g_string_append_c(buf, fields->aggregator);
+        g_string_append(buf, value);
+    }
+}
+
 static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
 {
     write_field_data_t *call_data;
@@ -1558,25 +1748,9 @@ static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
 
     field_index = g_hash_table_lookup(call_data->fields->field_indicies, fi->hfinfo->abbrev);
     if(NULL != field_index) {
-        const gchar* value;
-
-        value = get_node_field_value(fi, call_data->edt); /* ep_alloced string */
-
-        if(NULL != value && '\0' != *value) {
-            guint actual_index;
-            actual_index = GPOINTER_TO_UINT(field_index);
-            /* Unwrap change made to disambiguiate zero / null */
-            if ( call_data->fields->field_values[actual_index - 1] == NULL ) {
-                call_data->fields->field_values[actual_index - 1] = ep_strbuf_new(value);
-            } else if ( call_data->fields->occurrence == 'l' ) {
-                /* print only the value of the last occurrence of the field */
-                ep_strbuf_printf(call_data->fields->field_values[actual_index - 1],"%s",value);
-            } else if ( call_data->fields->occurrence == 'a' ) {
-                /* print the value of all accurrences of the field */
-                ep_strbuf_append_printf(call_data->fields->field_values[actual_index - 1],
-                    "%c%s",call_data->fields->aggregator,value);
-            }
-        }
+        /* Unwrap change made to disambiguiate zero / null */
+        output_fields_add_value(call_data->fields, GPOINTER_TO_UINT(field_index) - 1,
+                                get_node_field_value(fi, call_data->edt));
     }
 
     /* Recurse here. */
@@ -1586,9 +1760,33 @@ static void proto_tree_get_node_field_values(proto_node *node, gpointer data)
     }
 }
 
+/* Get the values of the fields from their primed lists of field_infos. */
+static void proto_tree_get_primed_field_values(output_fields_t* fields, epan_dissect_t *edt)
+{
+    header_field_info* hfinfo;
+    GPtrArray* finfos;
+    guint i, j;
+
+    for(i = 0; i < fields->fields->len; ++i) {
+        hfinfo = fields->field_hfinfos[i];
+        if(NULL == hfinfo) {
+            continue;
+        }
+        finfos = proto_get_finfo_ptr_array(edt->tree, hfinfo->id);
+        if(NULL == finfos) {
+            continue;
+        }
+        for(j = 0; j < finfos->len; ++j) {
+            output_fields_add_value(fields, i,
+                get_node_field_value((field_info *)g_ptr_array_index(finfos, j), edt));
+        }
+    }
+}
+
 void proto_tree_write_fields(output_fields_t* fields, epan_dissect_t *edt, FILE *fh)
 {
     gsize i;
+    GString* line;
 
     write_field_data_t data;
 
@@ -1599,41 +1797,44 @@ void proto_tree_write_fields(output_fields_t* fields, epan_dissect_t *edt, FILE
     data.fields = fields;
     data.edt = edt;
 
-    if(NULL == fields->field_indicies) {
-        /* Prepare a lookup table from string abbreviation for field to its index. */
-        fields->field_indicies = g_hash_table_new(g_str_hash, g_str_equal);
-
-        i = 0;
-        while( i < fields->fields->len) {
-            gchar* field = (gchar *)g_ptr_array_index(fields->fields, i);
-             /* Store field indicies +1 so that zero is not a valid value,
-              * and can be distinguished from NULL as a pointer.
-              */
-            ++i;
-            g_hash_table_insert(fields->field_indicies, field, GUINT_TO_POINTER(i));
-        }
-    }
+    output_fields_prepare(fields);
 
-    /* Buffer to store values for this packet */
-    fields->field_values = ep_alloc_array0(emem_strbuf_t*, fields->fields->len);
+    for(i = 0; i < fields->fields->len; ++i) {
+        g_string_truncate(fields->field_values[i], 0);
+    }
 
-    proto_tree_children_foreach(edt->tree, proto_tree_get_node_field_values,
-                                &data);
+    /*
+     * The lists of primed field_infos are kept per hfid, so if several
+     * hfids share a name, their values can't be merged back into tree
+     * order from them.  Walk the tree instead; with only our fields
+     * primed, it's small.
+     */
+    if(fields->primed && !fields->shared_names) {
+        proto_tree_get_primed_field_values(fields, edt);
+    } else {
+        proto_tree_children_foreach(edt->tree, proto_tree_get_node_field_values,
+                                    &data);
+    }
 
+    /* Put the line together and write it in one go */
+    line = output_buf_start();
     for(i = 0; i < fields->fields->len; ++i) {
         if(0 != i) {
-            fputc(fields->separator, fh);
+            g_string_append_c(line, fields->separator);
         }
-        if(NULL != fields->field_values[i]) {
+        if(0 != fields->field_values[i]->len) {
             if(fields->quote != '\0') {
-                fputc(fields->quote, fh);
+                g_string_append_c(line, fields->quote);
             }
-            fputs(fields->field_values[i]->str, fh);
+            g_string_append_len(line, fields->field_values[i]->str,
+                                fields->field_values[i]->len);
             if(fields->quote != '\0') {
-                fputc(fields->quote, fh);
+                g_string_append_c(line, fields->quote);
             }
         }
     }
+    g_string_append_c(line, '\n');
+    output_buf_write(line, fh);
 }
 
 void write_fields_finale(output_fields_t* fields _U_ , FILE *fh _U_)
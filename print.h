@@ -123,6 +123,8 @@ extern void output_fields_add(output_fields_t* info, const gchar* field);
 extern gsize output_fields_num_fields(output_fields_t* info);
 extern gboolean output_fields_set_option(output_fields_t* info, gchar* option);
 extern void output_fields_list_options(FILE *fh);
+extern gboolean output_fields_can_prime(output_fields_t* info);
+extern void output_fields_prime_edt(output_fields_t* info, epan_dissect_t *edt);
 
 /*
  * Output only these protocols
@@ -40,31 +40,49 @@
 #define N_PROGBAR_UPDATES	100
 
 #define STAT_NODE_STATS(n)   ((ph_stats_node_t*)(n)->data)
-#define STAT_NODE_HFINFO(n)  (STAT_NODE_STATS(n)->hfinfo)
 
+/* Key of the table used to find the child of a node for a protocol */
+typedef struct {
+	GNode	*parent;
+	int	proto_id;
+} stat_node_key_t;
+
+static guint
+stat_node_hash(gconstpointer v)
+{
+	const stat_node_key_t *key = (const stat_node_key_t *)v;
+
+	return g_direct_hash(key->parent) ^ ((guint)key->proto_id * 2654435761U);
+}
+
+static gboolean
+stat_node_equal(gconstpointer v, gconstpointer w)
+{
+	const stat_node_key_t *v1 = (const stat_node_key_t *)v;
+	const stat_node_key_t *v2 = (const stat_node_key_t *)w;
+
+	return v1->parent == v2->parent && v1->proto_id == v2->proto_id;
+}
 
 static GNode*
-find_stat_node(GNode *parent_stat_node, header_field_info *needle_hfinfo)
+find_stat_node(ph_stats_t *ps, GNode *parent_stat_node, int proto_id)
 {
+	stat_node_key_t		key, *new_key;
 	GNode			*needle_stat_node;
-	header_field_info	*hfinfo;
 	ph_stats_node_t         *stats;
 
-	needle_stat_node = g_node_first_child(parent_stat_node);
-
-	while (needle_stat_node) {
-		hfinfo = STAT_NODE_HFINFO(needle_stat_node);
-		if (hfinfo &&  hfinfo->id == needle_hfinfo->id) {
-			return needle_stat_node;
-		}
-		needle_stat_node = g_node_next_sibling(needle_stat_node);
+	key.parent = parent_stat_node;
+	key.proto_id = proto_id;
+	needle_stat_node = (GNode *)g_hash_table_lookup(ps->stat_nodes, &key);
+	if (needle_stat_node) {
+		return needle_stat_node;
 	}
 
 	/* None found. Create one. */
 	stats = g_new(ph_stats_node_t, 1);
 
 	/* Intialize counters */
-	stats->hfinfo = needle_hfinfo;
+	stats->hfinfo = proto_registrar_get_nth(proto_id);
 	stats->num_pkts_total = 0;
 	stats->num_pkts_last = 0;
 	stats->num_bytes_total = 0;
@@ -72,70 +90,44 @@ find_stat_node(GNode *parent_stat_node, header_field_info *needle_hfinfo)
 
 	needle_stat_node = g_node_new(stats);
 	g_node_append(parent_stat_node, needle_stat_node);
+
+	new_key = g_new(stat_node_key_t, 1);
+	*new_key = key;
+	g_hash_table_insert(ps->stat_nodes, new_key, needle_stat_node);
 	return needle_stat_node;
 }
 
 
+/*
+ * Count a packet in the node for each of the protocols it was dissected
+ * with, in the order they were dissected.  This is every dissector handle
+ * the packet was handed to, including ones called only to fill in a
+ * subtree, so it isn't necessarily the list of top-level items of the
+ * protocol tree; it also doesn't depend on whether a tree is being built,
+ * as long as dissectors don't make handle calls only "if (tree)".
+ */
 static void
-process_node(proto_node *ptree_node, GNode *parent_stat_node, ph_stats_t *ps, guint pkt_len)
+process_layers(GArray *layers, ph_stats_t *ps, guint pkt_len)
 {
-	field_info		*finfo;
-	ph_stats_node_t		*stats;
-	proto_node		*proto_sibling_node;
 	GNode			*stat_node;
+	ph_stats_node_t		*stats = NULL;
+	guint			i;
 
-	finfo = PNODE_FINFO(ptree_node);
-	/* We don't fake protocol nodes we expect them to have a field_info.
-	 * Dissection with faked proto tree? */
-	g_assert(finfo);
-
-	/* If the field info isn't related to a protocol but to a field,
-	 * don't count them, as they don't belong to any protocol.
-	 * (happens e.g. for toplevel tree item of desegmentation "[Reassembled TCP Segments]") */
-	if (finfo->hfinfo->parent != -1) {
-		/* Skip this element, use parent status node */
-		stat_node = parent_stat_node;
-		stats = STAT_NODE_STATS(stat_node);
-	} else {
-		stat_node = find_stat_node(parent_stat_node, finfo->hfinfo);
+	stat_node = ps->stats_tree;
+	for (i = 0; i < layers->len; i++) {
+		stat_node = find_stat_node(ps, stat_node, g_array_index(layers, int, i));
 
 		stats = STAT_NODE_STATS(stat_node);
 		stats->num_pkts_total++;
 		stats->num_bytes_total += pkt_len;
 	}
 
-	proto_sibling_node = ptree_node->next;
-
-	if (proto_sibling_node) {
-		/* If the name does not exist for this proto_sibling_node, then it is
-		 * not a normal protocol in the top-level tree.  It was instead
-		 * added as a normal tree such as IPv6's Hop-by-hop Option Header and
-		 * should be skipped when creating the protocol hierarchy display. */
-		if(strlen(PNODE_FINFO(proto_sibling_node)->hfinfo->name) == 0 && ptree_node->next)
-			proto_sibling_node = proto_sibling_node->next;
-
-		process_node(proto_sibling_node, stat_node, ps, pkt_len);
-	} else {
+	if (stats) {
 		stats->num_pkts_last++;
 		stats->num_bytes_last += pkt_len;
 	}
 }
 
-
-
-static void
-process_tree(proto_tree *protocol_tree, ph_stats_t* ps, guint pkt_len)
-{
-	proto_node	*ptree_node;
-
-	ptree_node = ((proto_node *)protocol_tree)->first_child;
-	if (!ptree_node) {
-		return;
-	}
-
-	process_node(ptree_node, ps->stats_tree, ps, pkt_len);
-}
-
 static gboolean
 process_frame(frame_data *frame, column_info *cinfo, ph_stats_t* ps)
 {
@@ -148,14 +140,12 @@ process_frame(frame_data *frame, column_info *cinfo, ph_stats_t* ps)
 	if (!cf_read_frame_r(&cfile, frame, &phdr, pd))
 		return FALSE;	/* failure */
 
-	/* Dissect the frame   tree  not visible */
-	epan_dissect_init(&edt, TRUE, FALSE);
-	/* Don't fake protocols. We need them for the protocol hierarchy */
-	epan_dissect_fake_protocols(&edt, FALSE);
+	/* Dissect the frame; we only need the layers, not a tree */
+	epan_dissect_init(&edt, FALSE, FALSE);
 	epan_dissect_run(&edt, &phdr, pd, frame, cinfo);
 
-	/* Get stats from this protocol tree */
-	process_tree(edt.tree, ps, frame->pkt_len);
+	/* Get stats from the protocols it was dissected with */
+	process_layers(edt.pi.layers, ps, frame->pkt_len);
 
 	/* Update times */
 	cur_time = nstime_to_sec(&frame->abs_ts);
@@ -193,6 +183,8 @@ ph_stats_new(void)
 	ps->tot_packets = 0;
 	ps->tot_bytes = 0;
 	ps->stats_tree = g_node_new(NULL);
+	ps->stat_nodes = g_hash_table_new_full(stat_node_hash, stat_node_equal,
+					       g_free, NULL);
 	ps->first_time = 0.0;
 	ps->last_time = 0.0;
 
@@ -329,6 +321,9 @@ ph_stats_free(ph_stats_t *ps)
 				stat_node_free, NULL);
 		g_node_destroy(ps->stats_tree);
 	}
+	if (ps->stat_nodes) {
+		g_hash_table_destroy(ps->stat_nodes);
+	}
 
 	g_free(ps);
 }
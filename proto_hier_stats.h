@@ -39,6 +39,7 @@ typedef struct {
 	guint	tot_packets;
 	guint	tot_bytes;
 	GNode	*stats_tree;
+	GHashTable *stat_nodes;	/* (parent node, protocol id) -> child node */
 	double	first_time;	/* seconds (msec resolution) of first packet */
 	double	last_time;	/* seconds (msec resolution) of last packet  */
 } ph_stats_t;
@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib.h>
@@ -36,6 +37,8 @@
 
 #include "wtap.h"
 
+#include <wsutil/file_util.h>
+
 #ifndef HAVE_GETOPT
 #include "wsutil/wsgetopt.h"
 #endif
@@ -55,6 +58,9 @@ static void usage(void)
     fprintf(stderr, "\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -n        don't write to output file if the input file is ordered.\n");
+    fprintf(stderr, "  -m <frames>\n");
+    fprintf(stderr, "            keep at most <frames> frames in memory; sort frames that\n");
+    fprintf(stderr, "            are further out of place via temporary files.\n");
 }
 
 /* Remember where this frame was in the file */
@@ -66,6 +72,23 @@ typedef struct FrameRecord_t {
     struct wtap_nstime   time;
 } FrameRecord_t;
 
+/* A frame held in memory, with its data (used with -m) */
+typedef struct BufferedFrame_t {
+    guint                num;
+    struct wtap_pkthdr   phdr;
+    guint8              *data;
+} BufferedFrame_t;
+
+/* A sorted run of frames in a temporary file, being merged */
+typedef struct RunFile_t {
+    char                *name;
+    FILE                *fh;        /* only open while being written or merged */
+    BufferedFrame_t     *frame;     /* the next frame of the run, or NULL */
+} RunFile_t;
+
+/* Most runs merged at once, so that we don't run out of file descriptors */
+#define MAX_MERGE_RUNS 64
+
 
 /**************************************************/
 /* Debugging only                                 */
@@ -119,14 +142,9 @@ frame_write(FrameRecord_t *frame, wtap *wth, wtap_dumper *pdh)
    1  if (t1 > t2)
 */
 static int
-frames_compare(gconstpointer a, gconstpointer b)
+times_compare(const struct wtap_nstime *time1, guint num1,
+              const struct wtap_nstime *time2, guint num2)
 {
-    const FrameRecord_t *frame1 = *(const FrameRecord_t **) a;
-    const FrameRecord_t *frame2 = *(const FrameRecord_t **) b;
-
-    const struct wtap_nstime *time1 = &frame1->time;
-    const struct wtap_nstime *time2 = &frame2->time;
-
     if (time1->secs > time2->secs)
         return 1;
     if (time1->secs < time2->secs)
@@ -140,13 +158,406 @@ frames_compare(gconstpointer a, gconstpointer b)
 
     /* time1->nsecs == time2->nsecs */
 
-    if (frame1->num > frame2->num)
+    if (num1 > num2)
         return 1;
-    if (frame1->num < frame2->num)
+    if (num1 < num2)
         return -1;
     return 0;
 }
 
+static int
+frames_compare(gconstpointer a, gconstpointer b)
+{
+    const FrameRecord_t *frame1 = *(const FrameRecord_t **) a;
+    const FrameRecord_t *frame2 = *(const FrameRecord_t **) b;
+
+    return times_compare(&frame1->time, frame1->num, &frame2->time, frame2->num);
+}
+
+static int
+buffered_frames_compare(gconstpointer a, gconstpointer b)
+{
+    const BufferedFrame_t *frame1 = *(const BufferedFrame_t **) a;
+    const BufferedFrame_t *frame2 = *(const BufferedFrame_t **) b;
+
+    return times_compare(&frame1->phdr.ts, frame1->num, &frame2->phdr.ts, frame2->num);
+}
+
+static int
+runs_compare(gconstpointer a, gconstpointer b)
+{
+    const RunFile_t *run1 = *(const RunFile_t **) a;
+    const RunFile_t *run2 = *(const RunFile_t **) b;
+
+    return buffered_frames_compare(&run1->frame, &run2->frame);
+}
+
+
+/**************************************************/
+/* Bounded-memory sorting (-m)                    */
+
+/* Binary min-heap, kept in a GPtrArray */
+static void
+heap_push(GPtrArray *heap, gpointer item, GCompareFunc compare)
+{
+    guint i, parent;
+
+    g_ptr_array_add(heap, item);
+    for (i = heap->len - 1; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (compare(&heap->pdata[parent], &heap->pdata[i]) <= 0)
+            break;
+        heap->pdata[i] = heap->pdata[parent];
+        heap->pdata[parent] = item;
+    }
+}
+
+static gpointer
+heap_pop(GPtrArray *heap, GCompareFunc compare)
+{
+    gpointer top, item;
+    guint i, child;
+
+    if (heap->len == 0)
+        return NULL;
+    top = heap->pdata[0];
+    item = g_ptr_array_remove_index(heap, heap->len - 1);
+    if (heap->len == 0)
+        return top;
+
+    /* Sift the last item down from the top */
+    heap->pdata[0] = item;
+    for (i = 0; (child = 2 * i + 1) < heap->len; i = child) {
+        if (child + 1 < heap->len &&
+            compare(&heap->pdata[child + 1], &heap->pdata[child]) < 0)
+            child++;
+        if (compare(&item, &heap->pdata[child]) <= 0)
+            break;
+        heap->pdata[i] = heap->pdata[child];
+        heap->pdata[child] = item;
+    }
+    return top;
+}
+
+static BufferedFrame_t *
+buffered_frame_new(wtap *wth, guint num)
+{
+    BufferedFrame_t *frame = g_slice_new(BufferedFrame_t);
+
+    frame->num = num;
+    frame->phdr = *wtap_phdr(wth);
+    frame->phdr.opt_comment = g_strdup(frame->phdr.opt_comment);
+    frame->data = g_memdup(wtap_buf_ptr(wth), frame->phdr.caplen);
+    return frame;
+}
+
+static void
+buffered_frame_free(BufferedFrame_t *frame)
+{
+    g_free(frame->phdr.opt_comment);
+    g_free(frame->data);
+    g_slice_free(BufferedFrame_t, frame);
+}
+
+static void
+buffered_frame_write(BufferedFrame_t *frame, wtap_dumper *pdh)
+{
+    int err;
+
+    if (!wtap_dump(pdh, &frame->phdr, frame->data, &err)) {
+        printf("Error (%s) writing frame to outfile\n", wtap_strerror(err));
+        exit(1);
+    }
+}
+
+/*
+ * Run files only live as long as this process, so the frame header is
+ * written as-is, followed by the comment (if any) and the data.
+ */
+static void
+run_write_frame(RunFile_t *run, const BufferedFrame_t *frame)
+{
+    guint32 comment_len;
+
+    comment_len = frame->phdr.opt_comment ? (guint32)strlen(frame->phdr.opt_comment) : 0;
+    if (fwrite(&frame->num, sizeof frame->num, 1, run->fh) != 1 ||
+        fwrite(&frame->phdr, sizeof frame->phdr, 1, run->fh) != 1 ||
+        fwrite(&comment_len, sizeof comment_len, 1, run->fh) != 1 ||
+        (comment_len != 0 &&
+         fwrite(frame->phdr.opt_comment, comment_len, 1, run->fh) != 1) ||
+        (frame->phdr.caplen != 0 &&
+         fwrite(frame->data, frame->phdr.caplen, 1, run->fh) != 1)) {
+        printf("Error writing temporary file %s: %s\n", run->name, g_strerror(errno));
+        exit(1);
+    }
+}
+
+/* Read the next frame of a run into run->frame; NULL at the end */
+static void
+run_read_frame(RunFile_t *run)
+{
+    BufferedFrame_t *frame;
+    guint num;
+    guint32 comment_len;
+
+    run->frame = NULL;
+    if (fread(&num, sizeof num, 1, run->fh) != 1) {
+        if (ferror(run->fh)) {
+            printf("Error reading temporary file %s: %s\n", run->name, g_strerror(errno));
+            exit(1);
+        }
+        return;
+    }
+    frame = g_slice_new(BufferedFrame_t);
+    frame->num = num;
+    if (fread(&frame->phdr, sizeof frame->phdr, 1, run->fh) != 1 ||
+        fread(&comment_len, sizeof comment_len, 1, run->fh) != 1) {
+        printf("Error reading temporary file %s\n", run->name);
+        exit(1);
+    }
+    frame->phdr.opt_comment = NULL;
+    if (comment_len != 0) {
+        frame->phdr.opt_comment = (gchar *)g_malloc(comment_len + 1);
+        if (fread(frame->phdr.opt_comment, comment_len, 1, run->fh) != 1) {
+            printf("Error reading temporary file %s\n", run->name);
+            exit(1);
+        }
+        frame->phdr.opt_comment[comment_len] = '\0';
+    }
+    frame->data = (guint8 *)g_malloc(frame->phdr.caplen);
+    if (frame->phdr.caplen != 0 &&
+        fread(frame->data, frame->phdr.caplen, 1, run->fh) != 1) {
+        printf("Error reading temporary file %s\n", run->name);
+        exit(1);
+    }
+    run->frame = frame;
+}
+
+/* Create an empty run file, open for writing */
+static RunFile_t *
+run_create(void)
+{
+    RunFile_t *run = g_new(RunFile_t, 1);
+    GError *error = NULL;
+    int fd;
+
+    fd = g_file_open_tmp("reordercap_XXXXXX", &run->name, &error);
+    if (fd == -1) {
+        printf("Can't create temporary file: %s\n", error->message);
+        exit(1);
+    }
+    ws_close(fd);
+    run->fh = ws_fopen(run->name, "wb");
+    if (run->fh == NULL) {
+        printf("Can't open temporary file %s: %s\n", run->name, g_strerror(errno));
+        exit(1);
+    }
+    run->frame = NULL;
+    return run;
+}
+
+/* Finish writing a run; it's reopened when it's merged */
+static void
+run_close(RunFile_t *run)
+{
+    if (fclose(run->fh) == EOF) {
+        printf("Error writing temporary file %s: %s\n", run->name, g_strerror(errno));
+        exit(1);
+    }
+    run->fh = NULL;
+}
+
+/* Open a run for merging, and read its first frame */
+static void
+run_open(RunFile_t *run)
+{
+    run->fh = ws_fopen(run->name, "rb");
+    if (run->fh == NULL) {
+        printf("Can't open temporary file %s: %s\n", run->name, g_strerror(errno));
+        exit(1);
+    }
+    run_read_frame(run);
+}
+
+/* Sort some frames and write them out as a new run */
+static RunFile_t *
+run_new(GPtrArray *frames)
+{
+    RunFile_t *run = run_create();
+    guint i;
+
+    DEBUG_PRINT("Writing run of %u frames to %s\n", frames->len, run->name);
+
+    g_ptr_array_sort(frames, buffered_frames_compare);
+    for (i = 0; i < frames->len; i++) {
+        run_write_frame(run, (BufferedFrame_t *)frames->pdata[i]);
+        buffered_frame_free((BufferedFrame_t *)frames->pdata[i]);
+    }
+    g_ptr_array_set_size(frames, 0);
+
+    run_close(run);
+    return run;
+}
+
+static void
+run_free(RunFile_t *run)
+{
+    if (run->fh != NULL)
+        fclose(run->fh);
+    ws_unlink(run->name);
+    g_free(run->name);
+    g_free(run);
+}
+
+/*
+ * Merge runs first .. first + count - 1, taking the earliest of their
+ * next frames each time, into the output file or, if "out" isn't NULL,
+ * into that run.  The merged runs are freed.
+ */
+static void
+merge_runs(GPtrArray *runs, guint first, guint count, wtap_dumper *pdh,
+           RunFile_t *out)
+{
+    GPtrArray *heap = g_ptr_array_new();
+    RunFile_t *run;
+    guint i;
+
+    for (i = first; i < first + count; i++) {
+        run = (RunFile_t *)runs->pdata[i];
+        run_open(run);
+        if (run->frame)
+            heap_push(heap, run, runs_compare);
+    }
+    while ((run = (RunFile_t *)heap_pop(heap, runs_compare)) != NULL) {
+        if (out != NULL)
+            run_write_frame(out, run->frame);
+        else
+            buffered_frame_write(run->frame, pdh);
+        buffered_frame_free(run->frame);
+        run_read_frame(run);
+        if (run->frame)
+            heap_push(heap, run, runs_compare);
+    }
+    g_ptr_array_free(heap, TRUE);
+
+    for (i = first; i < first + count; i++) {
+        run_free((RunFile_t *)runs->pdata[i]);
+    }
+}
+
+/*
+ * Single pass for nearly-sorted input: hold the last max_frames frames
+ * in a heap and write out the earliest whenever it is full.  Returns
+ * FALSE, having written part of the output, if some frame belongs before
+ * one that has already been written.
+ */
+static gboolean
+sort_window(wtap *wth, wtap_dumper *pdh, guint max_frames,
+            guint *frame_count, guint *wrong_order_count)
+{
+    GPtrArray *heap = g_ptr_array_new();
+    BufferedFrame_t *frame;
+    struct wtap_nstime prevTime, lastTime;
+    guint lastNum = 0;
+    gboolean written = FALSE;
+    gboolean ok = TRUE;
+    gint64 data_offset;
+    gchar *err_info;
+    int err;
+
+    *frame_count = 0;
+    *wrong_order_count = 0;
+    prevTime.secs = 0;
+    prevTime.nsecs = 0;
+    lastTime = prevTime;
+
+    while (wtap_read(wth, &err, &err_info, &data_offset)) {
+        frame = buffered_frame_new(wth, ++*frame_count);
+
+        if (frame->num > 1 && times_compare(&frame->phdr.ts, frame->num,
+                                            &prevTime, frame->num - 1) < 0) {
+            (*wrong_order_count)++;
+        }
+        prevTime = frame->phdr.ts;
+
+        if (written && times_compare(&frame->phdr.ts, frame->num, &lastTime, lastNum) < 0) {
+            DEBUG_PRINT("Frame %u is more than %u frames out of place\n",
+                        frame->num, max_frames);
+            buffered_frame_free(frame);
+            ok = FALSE;
+            break;
+        }
+
+        heap_push(heap, frame, buffered_frames_compare);
+        if (heap->len > max_frames) {
+            frame = (BufferedFrame_t *)heap_pop(heap, buffered_frames_compare);
+            buffered_frame_write(frame, pdh);
+            lastTime = frame->phdr.ts;
+            lastNum = frame->num;
+            written = TRUE;
+            buffered_frame_free(frame);
+        }
+    }
+
+    while ((frame = (BufferedFrame_t *)heap_pop(heap, buffered_frames_compare)) != NULL) {
+        if (ok)
+            buffered_frame_write(frame, pdh);
+        buffered_frame_free(frame);
+    }
+    g_ptr_array_free(heap, TRUE);
+    return ok;
+}
+
+/*
+ * External sort: sort runs of max_frames frames into temporary files,
+ * then merge them into the output.
+ */
+static void
+sort_runs(wtap *wth, wtap_dumper *pdh, guint max_frames)
+{
+    GPtrArray *frames = g_ptr_array_new();
+    GPtrArray *runs = g_ptr_array_new();
+    GPtrArray *merged;
+    RunFile_t *run;
+    guint num = 0;
+    guint i, count;
+    gint64 data_offset;
+    gchar *err_info;
+    int err;
+
+    while (wtap_read(wth, &err, &err_info, &data_offset)) {
+        g_ptr_array_add(frames, buffered_frame_new(wth, ++num));
+        if (frames->len == max_frames) {
+            g_ptr_array_add(runs, run_new(frames));
+        }
+    }
+    if (frames->len > 0) {
+        g_ptr_array_add(runs, run_new(frames));
+    }
+    g_ptr_array_free(frames, TRUE);
+
+    /* Merge at most MAX_MERGE_RUNS runs at a time into longer runs,
+       until there are few enough to merge straight into the output. */
+    while (runs->len > MAX_MERGE_RUNS) {
+        printf("Merging %u runs into %u\n", runs->len,
+               (runs->len + MAX_MERGE_RUNS - 1) / MAX_MERGE_RUNS);
+        merged = g_ptr_array_new();
+        for (i = 0; i < runs->len; i += count) {
+            count = MIN(runs->len - i, MAX_MERGE_RUNS);
+            run = run_create();
+            merge_runs(runs, i, count, NULL, run);
+            run_close(run);
+            g_ptr_array_add(merged, run);
+        }
+        g_ptr_array_free(runs, TRUE);
+        runs = merged;
+    }
+
+    printf("Merging %u runs\n", runs->len);
+    merge_runs(runs, 0, runs->len, pdh, NULL);
+    g_ptr_array_free(runs, TRUE);
+}
+
 
 /********************************************************************/
 /* Main function.                                                   */
@@ -161,6 +572,8 @@ int main(int argc, char *argv[])
     const struct wtap_pkthdr *phdr;
     guint wrong_order_count = 0;
     gboolean write_output_regardless = TRUE;
+    guint max_frames = 0;
+    guint frame_count;
     guint i;
 
     GPtrArray *frames;
@@ -168,12 +581,21 @@ int main(int argc, char *argv[])
 
     int opt;
     int file_count;
+    char *p;
     char *infile;
     char *outfile;
 
     /* Process the options first */
-    while ((opt = getopt(argc, argv, "n")) != -1) {
+    while ((opt = getopt(argc, argv, "m:n")) != -1) {
         switch (opt) {
+            case 'm':
+                max_frames = (guint)strtoul(optarg, &p, 10);
+                if (p == optarg || *p != '\0' || max_frames == 0) {
+                    fprintf(stderr, "reordercap: \"%s\" isn't a valid number of frames\n",
+                            optarg);
+                    exit(1);
+                }
+                break;
             case 'n':
                 write_output_regardless = FALSE;
                 break;
@@ -209,6 +631,43 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    if (max_frames != 0) {
+        /* Try a single pass first; most files are nearly in order */
+        if (sort_window(wth, pdh, max_frames, &frame_count, &wrong_order_count)) {
+            printf("%u frames, %u out of order\n", frame_count, wrong_order_count);
+        }
+        else {
+            printf("Frames are more than %u out of place, sorting via temporary files\n",
+                   max_frames);
+
+            /* Start again from the beginning */
+            wtap_dump_close(pdh, &err);
+            wtap_close(wth);
+            wth = wtap_open_offline(infile, &err, &err_info, TRUE);
+            if (wth == NULL) {
+                printf("reorder: Can't reopen %s: %s\n", infile, wtap_strerror(err));
+                exit(1);
+            }
+            pdh = wtap_dump_open(outfile, wtap_file_type(wth), wtap_file_encap(wth), 65535, FALSE, &err);
+            if (pdh == NULL) {
+                printf("Failed to open output file: (%s) - error %s\n", outfile, wtap_strerror(err));
+                exit(1);
+            }
+            sort_runs(wth, pdh, max_frames);
+        }
+
+        if (!wtap_dump_close(pdh, &err)) {
+            printf("Error closing %s: %s\n", outfile, wtap_strerror(err));
+            exit(1);
+        }
+        if (!write_output_regardless && (wrong_order_count == 0)) {
+            printf("Not writing output file because input file is already in order!\n");
+            ws_unlink(outfile);
+        }
+        wtap_close(wth);
+        return 0;
+    }
+
     /* Allocate the array of frame pointers. */
     frames = g_ptr_array_new();
 
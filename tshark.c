@@ -78,6 +78,7 @@
 #include <epan/epan_dissect.h>
 #include <epan/tap.h>
 #include <epan/stat_cmd_args.h>
+#include <epan/conversation.h>
 #include <epan/timestamp.h>
 #include <epan/ex-opt.h>
 
@@ -111,6 +112,9 @@ static frame_data prev_cap_frame;
 static const char* prev_display_dissector_name = NULL;
 
 static gboolean perform_two_pass_analysis;
+static gboolean use_read_ahead;   /* TRUE if "-j" was specified */
+static guint32 conv_idle_timeout; /* "-g" value; 0 means keep conversations forever */
+static guint32 session_reset_count; /* "-M" value; 0 means never reset */
 
 /*
  * The way the packet decode is to be written.
@@ -283,6 +287,11 @@ print_usage(gboolean print_ver)
   fprintf(output, "\n");
   fprintf(output, "Processing:\n");
   fprintf(output, "  -2                       perform a two-pass analysis\n");
+  fprintf(output, "  -j                       read the capture file on a separate thread\n");
+  fprintf(output, "  -g <seconds>             forget conversations idle for that long (one pass only)\n");
+  fprintf(output, "  -M <packet count>        discard all dissection state every <packet count> packets\n");
+  fprintf(output, "                           (one pass only; lossy: reassembly and conversations\n");
+  fprintf(output, "                           spanning a reset are cut off)\n");
   fprintf(output, "  -R <read filter>         packet filter in Wireshark display filter syntax\n");
   fprintf(output, "  -n                       disable all name resolutions (def: all enabled)\n");
   fprintf(output, "  -N <name resolve flags>  enable specific name resolution(s): \"mntC\"\n");
@@ -923,7 +932,7 @@ main(int argc, char *argv[])
 #define OPTSTRING_I ""
 #endif
 
-#define OPTSTRING "2a:" OPTSTRING_A "b:" OPTSTRING_B "c:C:d:De:E:f:F:G:hH:i:" OPTSTRING_I "K:lLnN:o:O:pPqr:R:s:S:t:T:u:vVw:W:xX:y:z:"
+#define OPTSTRING "2a:" OPTSTRING_A "b:" OPTSTRING_B "c:C:d:De:E:f:F:g:G:hH:i:" OPTSTRING_I "jK:lLM:nN:o:O:pPqr:R:s:S:t:T:u:vVw:W:xX:y:z:"
 
   static const char    optstring[] = OPTSTRING;
 
@@ -1285,6 +1294,16 @@ main(int argc, char *argv[])
       print_usage(TRUE);
       return 0;
       break;
+    case 'g':        /* Retire idle conversations */
+      conv_idle_timeout = get_positive_int(optarg, "conversation idle timeout");
+      break;
+    case 'j':        /* Read the capture file on a separate thread */
+#if !GLIB_CHECK_VERSION(2,31,0)
+      if (!g_thread_supported())
+        g_thread_init(NULL);
+#endif
+      use_read_ahead = TRUE;
+      break;
     case 'l':        /* "Line-buffer" standard output */
       /* This isn't line-buffering, strictly speaking, it's just
          flushing the standard output after the information for
@@ -1308,6 +1327,9 @@ main(int argc, char *argv[])
       arg_error = TRUE;
 #endif
       break;
+    case 'M':        /* Periodically reset dissection state */
+      session_reset_count = get_positive_int(optarg, "session reset packet count");
+      break;
     case 'n':        /* No name resolution */
       gbl_resolv_flags.mac_name = FALSE;
       gbl_resolv_flags.network_name = FALSE;
@@ -1471,6 +1493,19 @@ main(int argc, char *argv[])
     }
   }
 
+  if (conv_idle_timeout != 0) {
+    if (perform_two_pass_analysis) {
+      cmdarg_err("-g can't be used with -2.");
+      return 1;
+    }
+    conversation_set_idle_timeout(conv_idle_timeout);
+  }
+
+  if (session_reset_count != 0 && perform_two_pass_analysis) {
+    cmdarg_err("-M can't be used with -2.");
+    return 1;
+  }
+
   /* If we specified output fields, but not the output field type... */
   if(WRITE_FIELDS != output_action && 0 != output_fields_num_fields(output_fields)) {
         cmdarg_err("Output fields were specified with \"-e\", "
@@ -2655,6 +2690,7 @@ process_packet_second_pass(capture_file *cf, frame_data *fdata,
                gboolean filtering_tap_listeners, guint tap_flags)
 {
   gboolean create_proto_tree;
+  gboolean prime_fields;
   column_info *cinfo;
   epan_dissect_t edt;
   gboolean passed;
@@ -2682,14 +2718,22 @@ process_packet_second_pass(capture_file *cf, frame_data *fdata,
     /* The protocol tree will be "visible", i.e., printed, only if we're
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
-       ("packet_details" is true). */
-    epan_dissect_init(&edt, create_proto_tree, print_packet_info && print_details);
+       ("packet_details" is true).  If the details are just some fields,
+       they're primed instead and everything else is left out. */
+    prime_fields = print_packet_info && print_details &&
+                   output_action == WRITE_FIELDS &&
+                   output_fields_can_prime(output_fields);
+    epan_dissect_init(&edt, create_proto_tree,
+                      print_packet_info && print_details && !prime_fields);
 
     /* If we're running a read filter, prime the epan_dissect_t with that
        filter. */
     if (cf->rfcode)
       epan_dissect_prime_dfilter(&edt, cf->rfcode);
 
+    if (prime_fields)
+      output_fields_prime_edt(output_fields, &edt);
+
     col_custom_prime_edt(&edt, &cf->cinfo);
 
     /* We only need the columns if either
@@ -2756,6 +2800,245 @@ process_packet_second_pass(capture_file *cf, frame_data *fdata,
   return passed;
 }
 
+/*
+ * Read-ahead support for "-j".
+ *
+ * A separate thread calls wtap_read() and hands copies of the records to
+ * the main loop through a bounded pool of slots, so that file I/O and
+ * decompression overlap with dissection.  The epan library isn't thread
+ * safe, so all dissection (and thus all conversation, reassembly and
+ * other state) stays on the main thread, in frame order; the output is
+ * identical to what we'd produce without "-j".
+ *
+ * That includes name resolution records (pcapng NRBs): wiretap reports
+ * them from within wtap_read(), on the reader thread, so we queue them
+ * with the next record and add them to the host tables on the main thread
+ * just before that record is dissected, as would happen without "-j".
+ */
+#define READ_AHEAD_SLOTS      1024
+#define READ_AHEAD_INIT_SIZE  2048
+
+typedef struct {
+  gboolean           is_ipv6;
+  guint              ipv4_addr;
+  struct e_in6_addr  ipv6_addr;
+  gchar             *name;
+} read_ahead_name_t;
+
+typedef struct {
+  struct wtap_pkthdr phdr;
+  gint64             data_offset;
+  guchar            *pd;
+  guint32            pd_size;
+  GSList            *names;       /* read_ahead_name_t's seen before this record */
+} read_ahead_slot_t;
+
+typedef struct {
+  wtap              *wth;
+  read_ahead_slot_t *slots;
+  GAsyncQueue       *free_slots;  /* slots the reader thread may fill */
+  GAsyncQueue       *full_slots;  /* slots waiting to be processed */
+  read_ahead_slot_t *current;     /* slot handed out to the main loop */
+  GThread           *tid;
+  volatile gint      stop;        /* set to make the reader thread quit */
+  gboolean           done;        /* TRUE once we've seen the end marker */
+  int                err;
+  gchar             *err_info;
+  GSList            *names;       /* names read since the last record, newest first */
+} read_ahead_t;
+
+/* Queued by the reader thread after the last record, or on error */
+static read_ahead_slot_t read_ahead_eof;
+
+/* The reader thread's state, for the name resolution callbacks */
+static read_ahead_t *read_ahead_cur;
+
+static void
+read_ahead_new_ipv4(const guint addr, const gchar *name)
+{
+  read_ahead_name_t *rn = g_new0(read_ahead_name_t, 1);
+
+  rn->ipv4_addr = addr;
+  rn->name = g_strdup(name);
+  read_ahead_cur->names = g_slist_prepend(read_ahead_cur->names, rn);
+}
+
+static void
+read_ahead_new_ipv6(const void *addrp, const gchar *name)
+{
+  read_ahead_name_t *rn = g_new0(read_ahead_name_t, 1);
+
+  rn->is_ipv6 = TRUE;
+  memcpy(&rn->ipv6_addr, addrp, sizeof rn->ipv6_addr);
+  rn->name = g_strdup(name);
+  read_ahead_cur->names = g_slist_prepend(read_ahead_cur->names, rn);
+}
+
+/*
+ * Add queued names to the host tables (if "apply" is set), in the order
+ * in which they were read, and free them.
+ */
+static void
+read_ahead_names_flush(GSList *names, gboolean apply)
+{
+  GSList            *l;
+  read_ahead_name_t *rn;
+
+  names = g_slist_reverse(names);
+  for (l = names; l != NULL; l = l->next) {
+    rn = (read_ahead_name_t *)l->data;
+    if (apply) {
+      if (rn->is_ipv6)
+        add_ipv6_name(&rn->ipv6_addr, rn->name);
+      else
+        add_ipv4_name(rn->ipv4_addr, rn->name);
+    }
+    g_free(rn->name);
+    g_free(rn);
+  }
+  g_slist_free(names);
+}
+
+static gpointer
+read_ahead_thread(gpointer data)
+{
+  read_ahead_t      *ra = (read_ahead_t *)data;
+  read_ahead_slot_t *slot;
+  gint64             data_offset;
+
+  for (;;) {
+    slot = (read_ahead_slot_t *)g_async_queue_pop(ra->free_slots);
+    if (g_atomic_int_get(&ra->stop) ||
+        !wtap_read(ra->wth, &ra->err, &ra->err_info, &data_offset)) {
+      g_async_queue_push(ra->free_slots, slot);
+      break;
+    }
+    slot->phdr = *wtap_phdr(ra->wth);
+    slot->data_offset = data_offset;
+    slot->names = ra->names;
+    ra->names = NULL;
+    if (slot->phdr.caplen > slot->pd_size) {
+      slot->pd_size = slot->phdr.caplen;
+      slot->pd = (guchar *)g_realloc(slot->pd, slot->pd_size);
+    }
+    memcpy(slot->pd, wtap_buf_ptr(ra->wth), slot->phdr.caplen);
+    g_async_queue_push(ra->full_slots, slot);
+  }
+  g_async_queue_push(ra->full_slots, &read_ahead_eof);
+  return NULL;
+}
+
+static read_ahead_t *
+read_ahead_start(wtap *wth)
+{
+  read_ahead_t *ra;
+  guint         i;
+
+  ra = g_new0(read_ahead_t, 1);
+  ra->wth = wth;
+  read_ahead_cur = ra;
+  wtap_set_cb_new_ipv4(wth, read_ahead_new_ipv4);
+  wtap_set_cb_new_ipv6(wth, read_ahead_new_ipv6);
+  ra->slots = g_new0(read_ahead_slot_t, READ_AHEAD_SLOTS);
+  ra->free_slots = g_async_queue_new();
+  ra->full_slots = g_async_queue_new();
+  for (i = 0; i < READ_AHEAD_SLOTS; i++) {
+    ra->slots[i].pd_size = READ_AHEAD_INIT_SIZE;
+    ra->slots[i].pd = (guchar *)g_malloc(READ_AHEAD_INIT_SIZE);
+    g_async_queue_push(ra->free_slots, &ra->slots[i]);
+  }
+#if GLIB_CHECK_VERSION(2,31,0)
+  ra->tid = g_thread_new("Read ahead", read_ahead_thread, ra);
+#else
+  ra->tid = g_thread_create(read_ahead_thread, ra, TRUE, NULL);
+#endif
+  return ra;
+}
+
+/*
+ * Get the next record, either directly from wiretap or, if we're reading
+ * ahead, from the reader thread.  The returned header and data remain
+ * valid until the next call.
+ */
+static gboolean
+read_next_packet(capture_file *cf, read_ahead_t *ra, int *err,
+                 gchar **err_info, gint64 *data_offset,
+                 struct wtap_pkthdr **phdr, const guchar **pd)
+{
+  read_ahead_slot_t *slot;
+
+  if (ra == NULL) {
+    if (!wtap_read(cf->wth, err, err_info, data_offset))
+      return FALSE;
+    *phdr = wtap_phdr(cf->wth);
+    *pd = wtap_buf_ptr(cf->wth);
+    return TRUE;
+  }
+
+  if (ra->current != NULL) {
+    g_async_queue_push(ra->free_slots, ra->current);
+    ra->current = NULL;
+  }
+  slot = (read_ahead_slot_t *)g_async_queue_pop(ra->full_slots);
+  if (slot == &read_ahead_eof) {
+    /* The reader thread is done, so its trailing names are ours now */
+    read_ahead_names_flush(ra->names, TRUE);
+    ra->names = NULL;
+    ra->done = TRUE;
+    *err = ra->err;
+    *err_info = ra->err_info;
+    ra->err_info = NULL;
+    return FALSE;
+  }
+  read_ahead_names_flush(slot->names, TRUE);
+  slot->names = NULL;
+  ra->current = slot;
+  *data_offset = slot->data_offset;
+  *phdr = &slot->phdr;
+  *pd = slot->pd;
+  return TRUE;
+}
+
+/*
+ * Stop the reader thread, if it's still running, and free everything.
+ */
+static void
+read_ahead_finish(read_ahead_t *ra)
+{
+  read_ahead_slot_t *slot;
+  guint              i;
+
+  if (!ra->done) {
+    /* We stopped early (e.g., "-c"); make the reader thread quit and
+       throw away whatever it has already read. */
+    g_atomic_int_set(&ra->stop, 1);
+    if (ra->current != NULL) {
+      g_async_queue_push(ra->free_slots, ra->current);
+      ra->current = NULL;
+    }
+    while ((slot = (read_ahead_slot_t *)g_async_queue_pop(ra->full_slots)) != &read_ahead_eof)
+      g_async_queue_push(ra->free_slots, slot);
+    g_free(ra->err_info);
+  }
+  g_thread_join(ra->tid);
+
+  /* Names read along with records we never processed are discarded, as
+     they would have been had we stopped reading without "-j" */
+  read_ahead_names_flush(ra->names, FALSE);
+  wtap_set_cb_new_ipv4(ra->wth, add_ipv4_name);
+  wtap_set_cb_new_ipv6(ra->wth, (wtap_new_ipv6_callback_t) add_ipv6_name);
+  read_ahead_cur = NULL;
+
+  for (i = 0; i < READ_AHEAD_SLOTS; i++) {
+    read_ahead_names_flush(ra->slots[i].names, FALSE);
+    g_free(ra->slots[i].pd);
+  }
+  g_free(ra->slots);
+  g_async_queue_unref(ra->free_slots);
+  g_async_queue_unref(ra->full_slots);
+  g_free(ra);
+}
+
 static int
 load_cap_file(capture_file *cf, char *save_file, int out_file_type,
     gboolean out_file_name_res, int max_packet_count, gint64 max_byte_count)
@@ -2773,6 +3056,9 @@ load_cap_file(capture_file *cf, char *save_file, int out_file_type,
   wtapng_section_t *shb_hdr;
   wtapng_iface_descriptions_t *idb_inf;
   char         appname[100];
+  read_ahead_t *ra = NULL;
+  struct wtap_pkthdr *whdr;
+  const guchar *pd;
 
   shb_hdr = wtap_file_get_shb_info(cf->wth);
   idb_inf = wtap_file_get_idb_info(cf->wth);
@@ -2869,9 +3155,11 @@ load_cap_file(capture_file *cf, char *save_file, int out_file_type,
     /* Allocate a frame_data_sequence for all the frames. */
     cf->frames = new_frame_data_sequence();
 
-    while (wtap_read(cf->wth, &err, &err_info, &data_offset)) {
-      if (process_packet_first_pass(cf, data_offset, wtap_phdr(cf->wth),
-                         wtap_buf_ptr(cf->wth))) {
+    if (use_read_ahead)
+      ra = read_ahead_start(cf->wth);
+
+    while (read_next_packet(cf, ra, &err, &err_info, &data_offset, &whdr, &pd)) {
+      if (process_packet_first_pass(cf, data_offset, whdr, pd)) {
         /* Stop reading if we have the maximum number of packets;
          * When the -c option has not been used, max_packet_count
          * starts at 0, which practically means, never stop reading.
@@ -2884,6 +3172,11 @@ load_cap_file(capture_file *cf, char *save_file, int out_file_type,
       }
     }
 
+    if (ra != NULL) {
+      read_ahead_finish(ra);
+      ra = NULL;
+    }
+
     /* Close the sequential I/O side, to free up memory it requires. */
     wtap_sequential_close(cf->wth);
 
@@ -2945,18 +3238,20 @@ load_cap_file(capture_file *cf, char *save_file, int out_file_type,
     }
   }
   else {
+    if (use_read_ahead)
+      ra = read_ahead_start(cf->wth);
+
     framenum = 0;
-    while (wtap_read(cf->wth, &err, &err_info, &data_offset)) {
+    while (read_next_packet(cf, ra, &err, &err_info, &data_offset, &whdr, &pd)) {
       framenum++;
 
-      if (process_packet(cf, data_offset, wtap_phdr(cf->wth),
-                         wtap_buf_ptr(cf->wth),
+      if (process_packet(cf, data_offset, whdr, pd,
                          filtering_tap_listeners, tap_flags)) {
         /* Either there's no read filtering or this packet passed the
            filter, so, if we're writing to a capture file, write
            this packet out. */
         if (pdh != NULL) {
-          if (!wtap_dump(pdh, wtap_phdr(cf->wth), wtap_buf_ptr(cf->wth), &err)) {
+          if (!wtap_dump(pdh, whdr, pd, &err)) {
             /* Error writing to a capture file */
             switch (err) {
 
@@ -2991,6 +3286,11 @@ load_cap_file(capture_file *cf, char *save_file, int out_file_type,
         }
       }
     }
+
+    if (ra != NULL) {
+      read_ahead_finish(ra);
+      ra = NULL;
+    }
   }
 
   if (err != 0) {
@@ -3095,6 +3395,7 @@ process_packet(capture_file *cf, gint64 offset, struct wtap_pkthdr *whdr,
 {
   frame_data fdata;
   gboolean create_proto_tree;
+  gboolean prime_fields;
   column_info *cinfo;
   epan_dissect_t edt;
   gboolean passed;
@@ -3127,14 +3428,22 @@ process_packet(capture_file *cf, gint64 offset, struct wtap_pkthdr *whdr,
     /* The protocol tree will be "visible", i.e., printed, only if we're
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
-       ("packet_details" is true). */
-    epan_dissect_init(&edt, create_proto_tree, print_packet_info && print_details);
+       ("packet_details" is true).  If the details are just some fields,
+       they're primed instead and everything else is left out. */
+    prime_fields = print_packet_info && print_details &&
+                   output_action == WRITE_FIELDS &&
+                   output_fields_can_prime(output_fields);
+    epan_dissect_init(&edt, create_proto_tree,
+                      print_packet_info && print_details && !prime_fields);
 
     /* If we're running a read filter, prime the epan_dissect_t with that
        filter. */
     if (cf->rfcode)
       epan_dissect_prime_dfilter(&edt, cf->rfcode);
 
+    if (prime_fields)
+      output_fields_prime_edt(output_fields, &edt);
+
     col_custom_prime_edt(&edt, &cf->cinfo);
 
     /* We only need the columns if either
@@ -3150,6 +3459,10 @@ process_packet(capture_file *cf, gint64 offset, struct wtap_pkthdr *whdr,
     frame_data_set_before_dissect(&fdata, &cf->elapsed_time,
                                   &first_ts, prev_dis, prev_cap);
 
+    /* Conversations can only tell they've gone idle if they know the time */
+    if (conv_idle_timeout != 0)
+      conversation_set_packet_time(&fdata.abs_ts);
+
     epan_dissect_run_with_taps(&edt, whdr, pd, &fdata, cinfo);
 
     /* Run the read filter if we have one. */
@@ -3208,6 +3521,20 @@ process_packet(capture_file *cf, gint64 offset, struct wtap_pkthdr *whdr,
     epan_dissect_cleanup(&edt);
     frame_data_cleanup(&fdata);
   }
+
+  /* When reading an endless stream, state kept by the dissectors
+     (conversations, reassembly tables, TCP analysis and everything
+     else allocated with se_alloc()) would otherwise grow until we
+     exit.  Throw all of it away every "session_reset_count" packets;
+     dissectors treat the next packet as if it started a new capture,
+     apart from the frame numbers and time stamps, which carry on.
+     This is lossy, and documented as such: we can't tell whether any
+     reassembly is in progress, so PDUs and conversations spanning the
+     reset are cut off. */
+  if (session_reset_count != 0 && (cf->count % session_reset_count) == 0) {
+    cleanup_dissection();
+    init_dissection();
+  }
   return passed;
 }
 
@@ -3547,7 +3874,6 @@ print_packet(capture_file *cf, epan_dissect_t *edt)
       return !ferror(stdout);
     case WRITE_FIELDS:
       proto_tree_write_fields(output_fields, edt, stdout);
-      printf("\n");
       return !ferror(stdout);
     }
   }
@@ -0,0 +1,138 @@
+/* tap-heurstat.c
+ * Heuristic dissector statistics for tshark
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* This module lists, for each heuristic dissector, how often it was
+ * tried, how often it accepted the packet and how long it took. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+#include "epan/packet.h"
+#include "epan/proto.h"
+#include <epan/tap.h>
+#include <epan/stat_cmd_args.h>
+
+typedef struct _heur_stat_row_t {
+	const gchar *table_name;
+	heur_dtbl_entry_t *hdtbl_entry;
+} heur_stat_row_t;
+
+static void
+heurstat_add_table(const gchar *table_name, gpointer table, gpointer user_data)
+{
+	GArray *rows = user_data;
+	heur_dissector_list_t sub_dissectors = *(heur_dissector_list_t *)table;
+	GSList *entry;
+	heur_stat_row_t row;
+
+	for (entry = sub_dissectors; entry != NULL; entry = g_slist_next(entry)) {
+		row.table_name = table_name;
+		row.hdtbl_entry = (heur_dtbl_entry_t *)entry->data;
+		if (row.hdtbl_entry->calls == 0) {
+			continue;
+		}
+		g_array_append_val(rows, row);
+	}
+}
+
+/* most expensive first */
+static gint
+heurstat_compare(gconstpointer a, gconstpointer b)
+{
+	const heur_stat_row_t *row_a = a;
+	const heur_stat_row_t *row_b = b;
+
+	if (row_a->hdtbl_entry->time_spent > row_b->hdtbl_entry->time_spent)
+		return -1;
+	if (row_a->hdtbl_entry->time_spent < row_b->hdtbl_entry->time_spent)
+		return 1;
+	return 0;
+}
+
+static void
+heurstat_draw(void *unused _U_)
+{
+	GArray *rows;
+	heur_stat_row_t *row;
+	const char *proto_name;
+	guint i;
+
+	rows = g_array_new(FALSE, FALSE, sizeof(heur_stat_row_t));
+	dissector_all_heur_tables_foreach_table(heurstat_add_table, rows);
+	g_array_sort(rows, heurstat_compare);
+
+	printf("\n");
+	printf("===================================================================\n");
+	printf("Heuristic Dissector Statistics\n");
+	printf("Table           Dissector                Calls  Accepted   Time (s)  Avg (us)\n");
+	for (i = 0; i < rows->len; i++) {
+		row = &g_array_index(rows, heur_stat_row_t, i);
+		if (row->hdtbl_entry->protocol != NULL) {
+			proto_name = proto_get_protocol_filter_name(proto_get_id(row->hdtbl_entry->protocol));
+		} else {
+			proto_name = "(unknown)";
+		}
+		printf("%-15s %-18s %11u %9u %10.6f %9.3f\n",
+		       row->table_name, proto_name,
+		       row->hdtbl_entry->calls, row->hdtbl_entry->accepted,
+		       row->hdtbl_entry->time_spent,
+		       row->hdtbl_entry->time_spent * 1000000.0 / row->hdtbl_entry->calls);
+	}
+	printf("===================================================================\n");
+
+	g_array_free(rows, TRUE);
+}
+
+
+static void
+heurstat_init(const char *optarg, void* userdata _U_)
+{
+	GString *error_string;
+
+	if (strcmp("heur,stat", optarg) != 0) {
+		fprintf(stderr, "tshark: invalid \"-z heur,stat\" argument\n");
+		exit(1);
+	}
+
+	/* We don't look at the packets, we just want to be drawn at the end. */
+	error_string = register_tap_listener("frame", NULL, NULL, TL_REQUIRES_NOTHING, NULL, NULL, heurstat_draw);
+	if (error_string) {
+		fprintf(stderr, "tshark: Couldn't register heur,stat tap: %s\n",
+		    error_string->str);
+		g_string_free(error_string, TRUE);
+		exit(1);
+	}
+
+	heur_dissector_stats_enable(TRUE);
+}
+
+
+void
+register_tap_listener_heurstat(void)
+{
+	register_stat_cmd_arg("heur,stat", heurstat_init, NULL);
+}
@@ -1256,7 +1256,9 @@ register_io_tap(io_stat_t *io, int i, const char *filter)
         g_free(field);
     }
 
-    error_string=register_tap_listener("frame", &io->items[i], flt, TL_REQUIRES_PROTO_TREE, NULL,
+    /* The only field we read is the one being calculated; declaring it
+       lets the other fields be faked instead of put in the tree. */
+    error_string=register_tap_listener("frame", &io->items[i], flt, TL_REQUIRES_NOTHING, NULL,
                                        iostat_packet, i?NULL:iostat_draw);
     if(error_string){
         g_free(io->items);
@@ -1266,6 +1268,9 @@ register_io_tap(io_stat_t *io, int i, const char *filter)
         g_string_free(error_string, TRUE);
         exit(1);
     }
+    if(hfi){
+        set_tap_listener_fields(&io->items[i], &io->items[i].hf_index, 1);
+    }
 }
 
 static void
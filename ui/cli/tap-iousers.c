@@ -46,162 +46,23 @@
 #include <epan/dissectors/packet-fc.h>
 #include <epan/dissectors/packet-fddi.h>
 
+#include "ui/conversation_hash.h"
+
 typedef struct _io_users_t {
 	const char *type;
 	char *filter;
-	struct _io_users_item_t *items;
+	port_type ptype;
+	conv_hash_t hash;
 } io_users_t;
 
-typedef struct _io_users_item_t {
-    struct _io_users_item_t *next;
-    char                    *name1;
-    char                    *name2;
-    conv_id_t               conv_id;
-    address                 addr1;
-    address                 addr2;
-    guint32                 frames1;
-    guint32                 frames2;
-    guint64                 bytes1;
-    guint64                 bytes2;
-    nstime_t                start_time;
-    nstime_t                stop_time;
-} io_users_item_t;
-
-#define iousers_process_name_packet(iu, name1, name2, direction, pkt_len, ts) \
-    iousers_process_name_packet_with_conv_id(iu, name1, name2, CONV_ID_UNSET, direction, pkt_len, ts)
-
-void
-iousers_process_name_packet_with_conv_id(
-    io_users_t *iu,
-    char *name1,
-    char *name2,
-    conv_id_t conv_id,
-    int direction,
-    guint64 pkt_len,
-    nstime_t *ts)
-{
-	io_users_item_t *iui;
-
-	for(iui=iu->items;iui;iui=iui->next){
-		if((iui->conv_id==conv_id)
-            && (!strcmp(iui->name1, name1))
-            && (!strcmp(iui->name2, name2)) ){
-			break;
-		}
-	}
-
-	if(!iui){
-		iui=g_malloc(sizeof(io_users_item_t));
-		iui->next=iu->items;
-		iu->items=iui;
-		iui->name1=g_strdup(name1);
-		iui->name2=g_strdup(name2);
-        iui->conv_id=conv_id;
-		iui->frames1=0;
-		iui->frames2=0;
-		iui->bytes1=0;
-		iui->bytes2=0;
-		memcpy(&iui->start_time, ts, sizeof(iui->start_time));
-		memcpy(&iui->stop_time, ts, sizeof(iui->stop_time));
-	}
-	else {
-		if (nstime_cmp(ts, &iui->stop_time) > 0) {
-			memcpy(&iui->stop_time, ts, sizeof(iui->stop_time));
-		} else if (nstime_cmp(ts, &iui->start_time) < 0) {
-			memcpy(&iui->start_time, ts, sizeof(iui->start_time));
-		}
-	}
-
-	if(direction){
-		iui->frames1++;
-		iui->bytes1+=pkt_len;
-	} else {
-		iui->frames2++;
-		iui->bytes2+=pkt_len;
-	}
-}
-
-void
-iousers_process_address_packet(io_users_t *iu, const address *src, const address *dst, guint64 pkt_len, nstime_t *ts)
-{
-	const address *addr1, *addr2;
-	io_users_item_t *iui;
-
-	if(CMP_ADDRESS(src, dst)>0){
-		addr1=src;
-		addr2=dst;
-	} else {
-		addr2=src;
-		addr1=dst;
-	}
-
-	for(iui=iu->items;iui;iui=iui->next){
-		if((!CMP_ADDRESS(&iui->addr1, addr1))
-		&&(!CMP_ADDRESS(&iui->addr2, addr2)) ){
-			break;
-		}
-	}
-
-	if(!iui){
-		iui=g_malloc(sizeof(io_users_item_t));
-		iui->next=iu->items;
-		iu->items=iui;
-		COPY_ADDRESS(&iui->addr1, addr1);
-		iui->name1=g_strdup(ep_address_to_str(addr1));
-		COPY_ADDRESS(&iui->addr2, addr2);
-		iui->name2=g_strdup(ep_address_to_str(addr2));
-		iui->frames1=0;
-		iui->frames2=0;
-		iui->bytes1=0;
-		iui->bytes2=0;
-		memcpy(&iui->start_time, ts, sizeof(iui->start_time));
-		memcpy(&iui->stop_time, ts, sizeof(iui->stop_time));
-	}
-	else {
-		if (nstime_cmp(ts, &iui->stop_time) > 0) {
-			memcpy(&iui->stop_time, ts, sizeof(iui->stop_time));
-		} else if (nstime_cmp(ts, &iui->start_time) < 0) {
-			memcpy(&iui->start_time, ts, sizeof(iui->start_time));
-		}
-	}
-
-	if(!CMP_ADDRESS(dst, &iui->addr1)){
-		iui->frames1++;
-		iui->bytes1+=pkt_len;
-	} else {
-		iui->frames2++;
-		iui->bytes2+=pkt_len;
-	}
-}
-
 static int
 iousers_udpip_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, const void *vudph)
 {
 	io_users_t *iu=arg;
 	const e_udphdr *udph=vudph;
-	char name1[256],name2[256];
-	int direction=0;
-
-	if(udph->uh_sport>udph->uh_dport){
-		direction=0;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&udph->ip_src),get_udp_port(udph->uh_sport));
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&udph->ip_dst),get_udp_port(udph->uh_dport));
-	} else if(udph->uh_sport<udph->uh_dport){
-		direction=1;
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&udph->ip_src),get_udp_port(udph->uh_sport));
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&udph->ip_dst),get_udp_port(udph->uh_dport));
-	} else if(CMP_ADDRESS(&udph->ip_src, &udph->ip_dst)>0){
-		direction=0;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&udph->ip_src),get_udp_port(udph->uh_sport));
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&udph->ip_dst),get_udp_port(udph->uh_dport));
-	} else {
-		direction=1;
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&udph->ip_src),get_udp_port(udph->uh_sport));
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&udph->ip_dst),get_udp_port(udph->uh_dport));
-	}
 
-	iousers_process_name_packet(iu, name1, name2, direction, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
-	
+	add_conversation_item(&iu->hash, &udph->ip_src, &udph->ip_dst, udph->uh_sport, udph->uh_dport, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+
 	return 1;
 }
 
@@ -211,27 +72,8 @@ iousers_sctp_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, cons
 {
 	io_users_t *iu=arg;
 	const struct _sctp_info* sctph = vsctp;
-	char name1[256],name2[256], s_sport[10], s_dport[10];
-	int direction=0;
-
-	g_snprintf(s_sport, sizeof s_sport, "%d",sctph->sport);
-	g_snprintf(s_dport, sizeof s_dport, "%d",sctph->dport);
-
-	if(sctph->sport > sctph->dport) {
-		direction=0;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&sctph->ip_src),s_sport);
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&sctph->ip_dst),s_dport);
-	} else if(sctph->sport < sctph->dport) {
-		direction=1;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&sctph->ip_src),s_sport);
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&sctph->ip_dst),s_dport);
-	} else {
-		direction=0;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&sctph->ip_src),s_sport);
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&sctph->ip_dst),s_dport);
-	}
 
-	iousers_process_name_packet(iu, name1, name2, direction, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &sctph->ip_src, &sctph->ip_dst, sctph->sport, sctph->dport, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -242,28 +84,8 @@ iousers_tcpip_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, con
 {
 	io_users_t *iu=arg;
 	const struct tcpheader *tcph=vtcph;
-	char name1[256],name2[256];
-	int direction=0;
-
-	if(tcph->th_sport>tcph->th_dport){
-		direction=0;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&tcph->ip_src),get_tcp_port(tcph->th_sport));
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&tcph->ip_dst),get_tcp_port(tcph->th_dport));
-	} else if(tcph->th_sport<tcph->th_dport){
-		direction=1;
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&tcph->ip_src),get_tcp_port(tcph->th_sport));
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&tcph->ip_dst),get_tcp_port(tcph->th_dport));
-	} else if(CMP_ADDRESS(&tcph->ip_src, &tcph->ip_dst)>0){
-		direction=0;
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&tcph->ip_src),get_tcp_port(tcph->th_sport));
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&tcph->ip_dst),get_tcp_port(tcph->th_dport));
-	} else {
-		direction=1;
-		g_snprintf(name2,256,"%s:%s",ep_address_to_str(&tcph->ip_src),get_tcp_port(tcph->th_sport));
-		g_snprintf(name1,256,"%s:%s",ep_address_to_str(&tcph->ip_dst),get_tcp_port(tcph->th_dport));
-	}
 
-	iousers_process_name_packet_with_conv_id(iu, name1, name2, tcph->th_stream, direction, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &tcph->ip_src, &tcph->ip_dst, tcph->th_sport, tcph->th_dport, tcph->th_stream, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -275,7 +97,7 @@ iousers_ip_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, const
 	io_users_t *iu=arg;
 	const ws_ip *iph=vip;
 
-	iousers_process_address_packet(iu, &iph->ip_src, &iph->ip_dst, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &iph->ip_src, &iph->ip_dst, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -293,7 +115,7 @@ iousers_ipv6_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, cons
 	src.data = &ip6h->ip6_src;
 	dst.data = &ip6h->ip6_dst;
 
-	iousers_process_address_packet(iu, &src, &dst, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &src, &dst, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -304,7 +126,7 @@ iousers_ipx_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, const
 	io_users_t *iu=arg;
 	const ipxhdr_t *ipxh=vipx;
 
-	iousers_process_address_packet(iu, &ipxh->ipx_src, &ipxh->ipx_dst, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &ipxh->ipx_src, &ipxh->ipx_dst, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -315,7 +137,7 @@ iousers_fc_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, const
 	io_users_t *iu=arg;
 	const fc_hdr *fchdr=vfc;
 
-	iousers_process_address_packet(iu, &fchdr->s_id, &fchdr->d_id, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &fchdr->s_id, &fchdr->d_id, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -326,7 +148,7 @@ iousers_eth_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, const
 	io_users_t *iu=arg;
 	const eth_hdr *ehdr=veth;
 
-	iousers_process_address_packet(iu, &ehdr->src, &ehdr->dst, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &ehdr->src, &ehdr->dst, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -337,7 +159,7 @@ iousers_fddi_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, cons
 	io_users_t *iu=arg;
 	const fddi_hdr *ehdr=veth;
 
-	iousers_process_address_packet(iu, &ehdr->src, &ehdr->dst, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &ehdr->src, &ehdr->dst, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
@@ -348,53 +170,58 @@ iousers_tr_packet(void *arg, packet_info *pinfo, epan_dissect_t *edt _U_, const
 	io_users_t *iu=arg;
 	const tr_hdr *trhdr=vtr;
 
-	iousers_process_address_packet(iu, &trhdr->src, &trhdr->dst, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
+	add_conversation_item(&iu->hash, &trhdr->src, &trhdr->dst, 0, 0, CONV_ID_UNSET, 1, pinfo->fd->pkt_len, &pinfo->fd->rel_ts);
 
 	return 1;
 }
 
+/* The name of one end of a conversation, as printed */
+static const char *
+iousers_end_name(const io_users_t *iu, const address *addr, guint32 port)
+{
+	switch(iu->ptype){
+	case PT_TCP:
+		return ep_strdup_printf("%s:%s",ep_address_to_str(addr),get_tcp_port(port));
+	case PT_UDP:
+		return ep_strdup_printf("%s:%s",ep_address_to_str(addr),get_udp_port(port));
+	case PT_SCTP:
+		return ep_strdup_printf("%s:%u",ep_address_to_str(addr),port);
+	default:
+		return ep_address_to_str(addr);
+	}
+}
+
 static void
 iousers_draw(void *arg)
 {
 	io_users_t *iu = arg;
-	io_users_item_t *iui;
-	guint32 last_frames, max_frames;
+	conv_item_t *iui;
+	conv_item_t **top;
+	guint i, count;
 
 	printf("================================================================================\n");
 	printf("%s Conversations\n",iu->type);
 	printf("Filter:%s\n",iu->filter?iu->filter:"<No Filter>");
 	printf("                                               |       <-      | |       ->      | |     Total     |   Rel. Start   |   Duration   |\n");
 	printf("                                               | Frames  Bytes | | Frames  Bytes | | Frames  Bytes |                |              |\n");
-	max_frames=0xffffffff;
-	do {
-		last_frames=0;
-		for(iui=iu->items;iui;iui=iui->next){
-			guint32 tot_frames;
-			tot_frames=iui->frames1+iui->frames2;
-
-			if((tot_frames>last_frames)
-			&&(tot_frames<max_frames)){
-				last_frames=tot_frames;
-			}
-		}
-		for(iui=iu->items;iui;iui=iui->next){
-			guint32 tot_frames;
-			tot_frames=iui->frames1+iui->frames2;
-
-			if(tot_frames==last_frames){
-				printf("%-20s <-> %-20s  %6d %9" G_GINT64_MODIFIER "d  %6d %9" G_GINT64_MODIFIER "d  %6d %9" G_GINT64_MODIFIER "d  %14.9f   %12.4f\n",
-					iui->name1, iui->name2,
-					iui->frames1, iui->bytes1,
-					iui->frames2, iui->bytes2,
-					iui->frames1+iui->frames2,
-					iui->bytes1+iui->bytes2,
-					nstime_to_sec(&iui->start_time),
-					nstime_to_sec(&iui->stop_time) - nstime_to_sec(&iui->start_time)
-				);
-			}
-		}
-		max_frames=last_frames;
-	} while(last_frames);
+
+	/* Most frames first */
+	top = g_new(conv_item_t *, conversation_count(&iu->hash));
+	count = conversation_top_n(&iu->hash, conversation_count(&iu->hash), conversation_frames_compare, top);
+	for(i=0;i<count;i++){
+		iui=top[i];
+		printf("%-20s <-> %-20s  %6" G_GINT64_MODIFIER "u %9" G_GINT64_MODIFIER "u  %6" G_GINT64_MODIFIER "u %9" G_GINT64_MODIFIER "u  %6" G_GINT64_MODIFIER "u %9" G_GINT64_MODIFIER "u  %14.9f   %12.4f\n",
+			iousers_end_name(iu, &iui->src_address, iui->src_port),
+			iousers_end_name(iu, &iui->dst_address, iui->dst_port),
+			iui->rx_frames, iui->rx_bytes,
+			iui->tx_frames, iui->tx_bytes,
+			iui->rx_frames+iui->tx_frames,
+			iui->rx_bytes+iui->tx_bytes,
+			nstime_to_sec(&iui->start_time),
+			nstime_to_sec(&iui->stop_time) - nstime_to_sec(&iui->start_time)
+		);
+	}
+	g_free(top);
 	printf("================================================================================\n");
 }
 
@@ -404,6 +231,7 @@ iousers_init(const char *optarg, void* userdata _U_)
 	const char *filter=NULL;
 	const char *tap_type, *tap_type_name;
 	tap_packet_cb packet_func;
+	port_type ptype=PT_NONE;
 	io_users_t *iu=NULL;
 	GString *error_string;
 
@@ -443,6 +271,7 @@ iousers_init(const char *optarg, void* userdata _U_)
 		tap_type="tcp";
 		tap_type_name="TCP";
 		packet_func=iousers_tcpip_packet;
+		ptype=PT_TCP;
 	} else if(!strncmp(optarg,"conv,udp",8)){
 		if(optarg[8]==','){
 			filter=optarg+9;
@@ -452,6 +281,7 @@ iousers_init(const char *optarg, void* userdata _U_)
 		tap_type="udp";
 		tap_type_name="UDP";
 		packet_func=iousers_udpip_packet;
+		ptype=PT_UDP;
 	} else if(!strncmp(optarg,"conv,tr",7)){
 		if(optarg[7]==','){
 			filter=optarg+8;
@@ -497,6 +327,7 @@ iousers_init(const char *optarg, void* userdata _U_)
 		tap_type="sctp";
 		tap_type_name="SCTP";
 		packet_func=iousers_sctp_packet;
+		ptype=PT_SCTP;
 	} else {
 		fprintf(stderr, "tshark: invalid \"-z conv,<type>[,<filter>]\" argument\n");
 		fprintf(stderr,"   <type> must be one of\n");
@@ -513,9 +344,9 @@ iousers_init(const char *optarg, void* userdata _U_)
 	}
 
 
-	iu=g_malloc(sizeof(io_users_t));
-	iu->items=NULL;
+	iu=g_malloc0(sizeof(io_users_t));
 	iu->type=tap_type_name;
+	iu->ptype=ptype;
 	if(filter){
 		iu->filter=g_strdup(filter);
 	} else {
@@ -524,9 +355,7 @@ iousers_init(const char *optarg, void* userdata _U_)
 
 	error_string=register_tap_listener(tap_type, iu, filter, 0, NULL, packet_func, iousers_draw);
 	if(error_string){
-		if(iu->items){
-			g_free(iu->items);
-		}
+		g_free(iu->filter);
 		g_free(iu);
 		fprintf(stderr, "tshark: Couldn't register conversations tap: %s\n",
 		    error_string->str);
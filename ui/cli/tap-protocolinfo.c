@@ -116,7 +116,7 @@ protocolinfo_init(const char *optarg, void* userdata _U_)
 		rs->filter=NULL;
 	}
 
-	error_string=register_tap_listener("frame", rs, rs->filter, TL_REQUIRES_PROTO_TREE, NULL, protocolinfo_packet, NULL);
+	error_string=register_tap_listener("frame", rs, rs->filter, TL_REQUIRES_NOTHING, NULL, protocolinfo_packet, NULL);
 	if(error_string){
 		/* error, we failed to attach to the tap. complain and clean up */
 		fprintf(stderr, "tshark: Couldn't register proto,colinfo tap: %s\n",
@@ -127,6 +127,7 @@ protocolinfo_init(const char *optarg, void* userdata _U_)
 
 		exit(1);
 	}
+	set_tap_listener_fields(rs, &rs->hf_index, 1);
 }
 
 
@@ -44,6 +44,7 @@ typedef struct _phs_t {
 	const char *proto_name;
 	guint32 frames;
 	guint64 bytes;
+	GHashTable *level;	/* first node of a level only: protocol id -> node */
 } phs_t;
 
 
@@ -60,68 +61,57 @@ new_phs_t(phs_t *parent)
 	rs->proto_name=NULL;
 	rs->frames=0;
 	rs->bytes=0;
+	rs->level=NULL;
 	return rs;
 }
 
 
 static int
-protohierstat_packet(void *prs, packet_info *pinfo, epan_dissect_t *edt, const void *dummy _U_)
+protohierstat_packet(void *prs, packet_info *pinfo, epan_dissect_t *edt _U_, const void *dummy _U_)
 {
 	phs_t *rs=prs;
 	phs_t *tmprs;
-	proto_node *node;
-	field_info *fi;
+	int proto_id;
+	guint i;
 
-	if(!edt){
-		return 0;
-	}
-	if(!edt->tree){
-		return 0;
-	}
-	if(!edt->tree->first_child){
+	/* The protocols the packet was dissected with, outermost first */
+	if(!pinfo->layers || pinfo->layers->len==0){
 		return 0;
 	}
 
-	for(node=edt->tree->first_child;node;node=node->next){
-		fi=PNODE_FINFO(node);
+	for(i=0;i<pinfo->layers->len;i++){
+		proto_id=g_array_index(pinfo->layers, int, i);
 
-		/* first time we saw a protocol at this leaf */
 		if(rs->protocol==-1){
-			rs->protocol=fi->hfinfo->id;
-			rs->proto_name=fi->hfinfo->abbrev;
-			rs->frames=1;
-			rs->bytes=pinfo->fd->pkt_len;
-			rs->child=new_phs_t(rs);
-			rs=rs->child;
-			continue;
-		}
-
-		/* find this protocol in the list of siblings */
-		for(tmprs=rs;tmprs;tmprs=tmprs->sibling){
-			if(tmprs->protocol==fi->hfinfo->id){
-				break;
-			}
-		}
-
-		/* not found, then we must add it to the end of the list */
-		if(!tmprs){
-			for(tmprs=rs;tmprs->sibling;tmprs=tmprs->sibling)
-				;
-			tmprs->sibling=new_phs_t(rs->parent);
-			rs=tmprs->sibling;
-			rs->protocol=fi->hfinfo->id;
-			rs->proto_name=fi->hfinfo->abbrev;
+			/* first time we saw a protocol at this leaf */
+			rs->protocol=proto_id;
+			rs->proto_name=proto_get_protocol_filter_name(proto_id);
+			rs->level=g_hash_table_new(g_direct_hash, g_direct_equal);
+			g_hash_table_insert(rs->level, GINT_TO_POINTER(proto_id), rs);
+			tmprs=rs;
 		} else {
-			rs=tmprs;
+			/* find this protocol among the siblings */
+			tmprs=g_hash_table_lookup(rs->level, GINT_TO_POINTER(proto_id));
+
+			/* not found, then we must add it to the end of the list */
+			if(!tmprs){
+				for(tmprs=rs;tmprs->sibling;tmprs=tmprs->sibling)
+					;
+				tmprs->sibling=new_phs_t(rs->parent);
+				tmprs=tmprs->sibling;
+				tmprs->protocol=proto_id;
+				tmprs->proto_name=proto_get_protocol_filter_name(proto_id);
+				g_hash_table_insert(rs->level, GINT_TO_POINTER(proto_id), tmprs);
+			}
 		}
 
-		rs->frames++;
-		rs->bytes+=pinfo->fd->pkt_len;
+		tmprs->frames++;
+		tmprs->bytes+=pinfo->fd->pkt_len;
 
-		if(!rs->child){
-			rs->child=new_phs_t(rs);
+		if(!tmprs->child){
+			tmprs->child=new_phs_t(tmprs);
 		}
-		rs=rs->child;
+		rs=tmprs->child;
 	}
 	return 1;
 }
@@ -192,7 +182,7 @@ protohierstat_init(const char *optarg, void* userdata _U_)
 		rs->filter=NULL;
 	}
 
-	error_string=register_tap_listener("frame", rs, filter, TL_REQUIRES_PROTO_TREE, NULL, protohierstat_packet, protohierstat_draw);
+	error_string=register_tap_listener("frame", rs, filter, TL_REQUIRES_NOTHING, NULL, protohierstat_packet, protohierstat_draw);
 	if(error_string){
 		/* error, we failed to attach to the tap. clean up */
 		g_free(rs->filter);
@@ -0,0 +1,313 @@
+/* conversation_hash.c
+ *
+ * $Id$
+ *
+ * Toolkit-independent conversation statistics.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "ui/conversation_hash.h"
+
+/*
+ * FNV-1a over the address type and bytes.  Summing the bytes, as
+ * ADD_ADDRESS_TO_HASH does, puts all IPv4 addresses in about a
+ * thousand buckets, which is far too few for big tables.
+ */
+#define FNV_PRIME 16777619U
+
+static guint
+hash_address(guint hash_val, const address *addr)
+{
+    const guint8 *data = (const guint8 *)addr->data;
+    int i;
+
+    hash_val = (hash_val ^ (guint)addr->type) * FNV_PRIME;
+    for (i = 0; i < addr->len; i++)
+        hash_val = (hash_val ^ data[i]) * FNV_PRIME;
+    return hash_val;
+}
+
+static guint
+hash_guint32(guint hash_val, guint32 val)
+{
+    hash_val = (hash_val ^ (val & 0xff)) * FNV_PRIME;
+    hash_val = (hash_val ^ ((val >> 8) & 0xff)) * FNV_PRIME;
+    hash_val = (hash_val ^ ((val >> 16) & 0xff)) * FNV_PRIME;
+    hash_val = (hash_val ^ (val >> 24)) * FNV_PRIME;
+    return hash_val;
+}
+
+guint
+conversation_hash(gconstpointer v)
+{
+    const conv_key_t *key = (const conv_key_t *)v;
+    guint hash_val = 2166136261U;
+
+    hash_val = hash_address(hash_val, &key->addr1);
+    hash_val = hash_guint32(hash_val, key->port1);
+    hash_val = hash_address(hash_val, &key->addr2);
+    hash_val = hash_guint32(hash_val, key->port2);
+    hash_val = hash_guint32(hash_val, key->conv_id);
+
+    return hash_val;
+}
+
+gboolean
+conversation_equal(gconstpointer v, gconstpointer w)
+{
+    const conv_key_t *v1 = (const conv_key_t *)v;
+    const conv_key_t *v2 = (const conv_key_t *)w;
+
+    if (v1->conv_id != v2->conv_id)
+        return FALSE;
+
+    return v1->port1 == v2->port1 &&
+           v1->port2 == v2->port2 &&
+           ADDRESSES_EQUAL(&v1->addr1, &v2->addr1) &&
+           ADDRESSES_EQUAL(&v1->addr2, &v2->addr2);
+}
+
+gboolean
+conversation_key_init(conv_key_t *key, const address *src, const address *dst,
+                      guint32 src_port, guint32 dst_port, conv_id_t conv_id)
+{
+    gboolean from_1;
+
+    if (src_port != dst_port)
+        from_1 = src_port > dst_port;
+    else
+        from_1 = CMP_ADDRESS(src, dst) > 0;
+
+    if (from_1) {
+        key->addr1 = *src;
+        key->addr2 = *dst;
+        key->port1 = src_port;
+        key->port2 = dst_port;
+    } else {
+        key->addr1 = *dst;
+        key->addr2 = *src;
+        key->port1 = dst_port;
+        key->port2 = src_port;
+    }
+    key->conv_id = conv_id;
+
+    return from_1;
+}
+
+conv_item_t *
+add_conversation_item(conv_hash_t *ch, const address *src, const address *dst,
+                      guint32 src_port, guint32 dst_port, conv_id_t conv_id,
+                      guint num_frames, guint num_bytes, const nstime_t *ts)
+{
+    conv_key_t key, *new_key;
+    conv_item_t *conv_item = NULL;
+    conv_item_t new_item;
+    guint idx;
+    gboolean from_1;
+
+    from_1 = conversation_key_init(&key, src, dst, src_port, dst_port, conv_id);
+
+    if (ch->conv_array == NULL) {
+        ch->conv_array = g_array_sized_new(FALSE, FALSE, sizeof(conv_item_t), 10000);
+        ch->hashtable = g_hash_table_new_full(conversation_hash,
+                                              conversation_equal,
+                                              g_free, NULL);
+    } else {
+        idx = GPOINTER_TO_UINT(g_hash_table_lookup(ch->hashtable, &key));
+        if (idx) {
+            conv_item = &g_array_index(ch->conv_array, conv_item_t, idx - 1);
+        }
+    }
+
+    if (conv_item == NULL) {
+        COPY_ADDRESS(&new_item.src_address, &key.addr1);
+        COPY_ADDRESS(&new_item.dst_address, &key.addr2);
+        new_item.src_port = key.port1;
+        new_item.dst_port = key.port2;
+        new_item.conv_id = conv_id;
+        new_item.rx_frames = 0;
+        new_item.tx_frames = 0;
+        new_item.rx_bytes = 0;
+        new_item.tx_bytes = 0;
+        if (ts) {
+            new_item.start_time = *ts;
+            new_item.stop_time = *ts;
+        } else {
+            nstime_set_unset(&new_item.start_time);
+            nstime_set_unset(&new_item.stop_time);
+        }
+        g_array_append_val(ch->conv_array, new_item);
+        conv_item = &g_array_index(ch->conv_array, conv_item_t, ch->conv_array->len - 1);
+
+        /* The array moves as it grows, but the address data doesn't. */
+        new_key = g_new(conv_key_t, 1);
+        SET_ADDRESS(&new_key->addr1, conv_item->src_address.type, conv_item->src_address.len, conv_item->src_address.data);
+        SET_ADDRESS(&new_key->addr2, conv_item->dst_address.type, conv_item->dst_address.len, conv_item->dst_address.data);
+        new_key->port1 = key.port1;
+        new_key->port2 = key.port2;
+        new_key->conv_id = conv_id;
+        g_hash_table_insert(ch->hashtable, new_key, GUINT_TO_POINTER(ch->conv_array->len));
+    } else if (ts) {
+        if (nstime_cmp(ts, &conv_item->stop_time) > 0) {
+            conv_item->stop_time = *ts;
+        } else if (nstime_cmp(ts, &conv_item->start_time) < 0) {
+            conv_item->start_time = *ts;
+        }
+    }
+
+    if (from_1) {
+        conv_item->tx_frames += num_frames;
+        conv_item->tx_bytes += num_bytes;
+    } else {
+        conv_item->rx_frames += num_frames;
+        conv_item->rx_bytes += num_bytes;
+    }
+
+    return conv_item;
+}
+
+guint
+conversation_count(const conv_hash_t *ch)
+{
+    return ch->conv_array ? ch->conv_array->len : 0;
+}
+
+/* Does a rank below b?  Ties go to the one added later. */
+static gboolean
+ranks_below(GCompareFunc compare, const conv_item_t *a, const conv_item_t *b)
+{
+    gint cmp = compare(a, b);
+
+    if (cmp != 0)
+        return cmp > 0;
+    return a < b;
+}
+
+/*
+ * Sift an item down from the top of a heap in which every item ranks
+ * at or below its children, i.e. the lowest ranking item is on top.
+ */
+static void
+top_n_sift_down(conv_item_t **heap, guint len, guint i, GCompareFunc compare)
+{
+    conv_item_t *item = heap[i];
+    guint child;
+
+    while ((child = 2 * i + 1) < len) {
+        if (child + 1 < len && ranks_below(compare, heap[child + 1], heap[child]))
+            child++;
+        if (!ranks_below(compare, heap[child], item))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+guint
+conversation_top_n(conv_hash_t *ch, guint n, GCompareFunc compare, conv_item_t **top)
+{
+    guint count = conversation_count(ch);
+    guint len = 0, i, j;
+    conv_item_t *item;
+
+    if (n > count)
+        n = count;
+    if (n == 0)
+        return 0;
+
+    /* Keep the n highest seen so far, lowest of them on top. */
+    for (i = 0; i < count; i++) {
+        item = &g_array_index(ch->conv_array, conv_item_t, i);
+        if (len < n) {
+            /* Sift up */
+            for (j = len++; j > 0 && ranks_below(compare, item, top[(j - 1) / 2]); j = (j - 1) / 2)
+                top[j] = top[(j - 1) / 2];
+            top[j] = item;
+        } else if (ranks_below(compare, top[0], item)) {
+            top[0] = item;
+            top_n_sift_down(top, len, 0, compare);
+        }
+    }
+
+    /* Take the lowest off the top repeatedly, filling in from the end. */
+    for (i = len; i > 1; i--) {
+        item = top[0];
+        top[0] = top[i - 1];
+        top[i - 1] = item;
+        top_n_sift_down(top, i - 1, 0, compare);
+    }
+    return len;
+}
+
+gint
+conversation_frames_compare(gconstpointer a, gconstpointer b)
+{
+    const conv_item_t *item_a = (const conv_item_t *)a;
+    const conv_item_t *item_b = (const conv_item_t *)b;
+    guint64 frames_a = item_a->rx_frames + item_a->tx_frames;
+    guint64 frames_b = item_b->rx_frames + item_b->tx_frames;
+
+    if (frames_a > frames_b)
+        return -1;
+    if (frames_a < frames_b)
+        return 1;
+    return 0;
+}
+
+void
+reset_conversation_items(conv_hash_t *ch)
+{
+    conv_item_t *conv_item;
+    guint i;
+
+    if (ch->conv_array != NULL) {
+        for (i = 0; i < ch->conv_array->len; i++) {
+            conv_item = &g_array_index(ch->conv_array, conv_item_t, i);
+            g_free((gpointer)conv_item->src_address.data);
+            g_free((gpointer)conv_item->dst_address.data);
+        }
+        g_array_free(ch->conv_array, TRUE);
+        ch->conv_array = NULL;
+    }
+    if (ch->hashtable != NULL) {
+        g_hash_table_destroy(ch->hashtable);
+        ch->hashtable = NULL;
+    }
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
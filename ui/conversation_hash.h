@@ -0,0 +1,164 @@
+/* conversation_hash.h
+ *
+ * $Id$
+ *
+ * Toolkit-independent conversation statistics.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __CONVERSATION_HASH_H__
+#define __CONVERSATION_HASH_H__
+
+#include <epan/address.h>
+#include <epan/conv_id.h>
+#include <epan/nstime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ *  Conversation statistics that any user interface can collect.
+ */
+
+/** The key of a conversation: both ends, in the order in which they are
+ * stored, and the conversation ID if the protocol has one. */
+typedef struct _conv_key_t {
+    address     addr1;
+    address     addr2;
+    guint32     port1;
+    guint32     port2;
+    conv_id_t   conv_id;
+} conv_key_t;
+
+/** Hash a conversation key.  The ends are hashed in order, so callers
+ * must always put the ends of a conversation in the same order.
+ *
+ * @param v The conv_key_t.
+ * @return The hash value.
+ */
+extern guint conversation_hash(gconstpointer v);
+
+/** Compare two conversation keys.  They match if their ends, in order,
+ * and their conversation IDs are the same.
+ *
+ * @param v One conv_key_t.
+ * @param w The other conv_key_t.
+ * @return TRUE if they are the same conversation.
+ */
+extern gboolean conversation_equal(gconstpointer v, gconstpointer w);
+
+/** Fill in the key of the conversation a packet belongs to.  Of the two
+ * ends, the one with the higher port, or with the higher address if the
+ * ports are the same, is the "1" end.  User interfaces that keep their
+ * own tables use this so that their ends are in the same order as here.
+ *
+ * @param[out] key The key.  Its addresses point at the packet's data.
+ * @param src The source address of the packet.
+ * @param dst The destination address of the packet.
+ * @param src_port The source port of the packet, or 0.
+ * @param dst_port The destination port of the packet, or 0.
+ * @param conv_id The conversation ID, or CONV_ID_UNSET.
+ * @return TRUE if the packet was sent from the "1" end.
+ */
+extern gboolean conversation_key_init(conv_key_t *key,
+    const address *src, const address *dst, guint32 src_port, guint32 dst_port,
+    conv_id_t conv_id);
+
+/** The statistics of one conversation. */
+typedef struct _conv_item_t {
+    address     src_address;    /**< address of the "1" end */
+    address     dst_address;    /**< address of the "2" end */
+    guint32     src_port;       /**< port of the "1" end, or 0 */
+    guint32     dst_port;       /**< port of the "2" end, or 0 */
+    conv_id_t   conv_id;        /**< conversation id */
+
+    guint64     rx_frames;      /**< number of packets sent to the "1" end */
+    guint64     tx_frames;      /**< number of packets sent from the "1" end */
+    guint64     rx_bytes;       /**< number of bytes sent to the "1" end */
+    guint64     tx_bytes;       /**< number of bytes sent from the "1" end */
+
+    nstime_t    start_time;     /**< time of the first packet */
+    nstime_t    stop_time;      /**< time of the last packet */
+} conv_item_t;
+
+/** A table of conversations. */
+typedef struct _conv_hash_t {
+    GHashTable  *hashtable;     /**< conv_key_t -> index into conv_array + 1 */
+    GArray      *conv_array;    /**< array of conv_item_t, in the order added */
+} conv_hash_t;
+
+/** Count a packet in its conversation, adding the conversation to the
+ * table if it isn't there yet.  The ends are ordered as by
+ * conversation_key_init().
+ *
+ * @param ch The table, zeroed before its first use.
+ * @param src The source address of the packet.
+ * @param dst The destination address of the packet.
+ * @param src_port The source port of the packet, or 0.
+ * @param dst_port The destination port of the packet, or 0.
+ * @param conv_id The conversation ID, or CONV_ID_UNSET.
+ * @param num_frames The number of frames to count.
+ * @param num_bytes The number of bytes to count.
+ * @param ts The time of the packet, or NULL.
+ * @return The conversation.  It is only valid until the next call.
+ */
+extern conv_item_t *add_conversation_item(conv_hash_t *ch,
+    const address *src, const address *dst, guint32 src_port, guint32 dst_port,
+    conv_id_t conv_id, guint num_frames, guint num_bytes, const nstime_t *ts);
+
+/** Get the number of conversations in a table.
+ *
+ * @param ch The table.
+ * @return The number of conversations.
+ */
+extern guint conversation_count(const conv_hash_t *ch);
+
+/** Find the conversations that rank highest, without sorting the whole
+ * table.  This is cheap enough to call whenever a display is refreshed.
+ *
+ * @param ch The table.
+ * @param n The number of conversations wanted.
+ * @param compare Returns a negative value if its first conv_item_t
+ * ranks above its second, a positive value if below, and 0 if they
+ * rank the same; of those, the most recently added ranks above.
+ * @param[out] top Filled in with up to n conversations, highest first.
+ * The pointers are only valid until a conversation is added.
+ * @return The number of conversations in top.
+ */
+extern guint conversation_top_n(conv_hash_t *ch, guint n,
+    GCompareFunc compare, conv_item_t **top);
+
+/** Rank conversations by the total number of frames, most first.
+ * Suitable for conversation_top_n().
+ */
+extern gint conversation_frames_compare(gconstpointer a, gconstpointer b);
+
+/** Free the conversations in a table, leaving it empty.
+ *
+ * @param ch The table.
+ */
+extern void reset_conversation_items(conv_hash_t *ch);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __CONVERSATION_HASH_H__ */
@@ -39,6 +39,7 @@
 
 #include "../globals.h"
 
+#include "ui/conversation_hash.h"
 #include "ui/simple_dialog.h"
 #include "ui/utf8_entities.h"
 
@@ -2857,68 +2858,6 @@ init_conversation_notebook_cb(GtkWidget *w _U_, gpointer d _U_)
     gdk_window_raise(gtk_widget_get_window(win));
 }
 
-typedef struct _key {
-    address     addr1;
-    address     addr2;
-    guint32     port1;
-    guint32     port2;
-    conv_id_t   conv_id;
-} conv_key_t;
-
-
-/*
- * Compute the hash value for two given address/port pairs if the match
- * is to be exact.
- */
-static guint
-conversation_hash(gconstpointer v)
-{
-    const conv_key_t *key = (const conv_key_t *)v;
-    guint hash_val;
-
-    hash_val = 0;
-    ADD_ADDRESS_TO_HASH(hash_val, &key->addr1);
-    hash_val += key->port1;
-    ADD_ADDRESS_TO_HASH(hash_val, &key->addr2);
-    hash_val += key->port2;
-    hash_val ^= key->conv_id;
-
-    return hash_val;
-}
-
-/*
- * Compare two conversation keys for an exact match.
- */
-static gint
-conversation_match(gconstpointer v, gconstpointer w)
-{
-    const conv_key_t *v1 = (const conv_key_t *)v;
-    const conv_key_t *v2 = (const conv_key_t *)w;
-
-    if (v1->conv_id == v2->conv_id)
-    {
-        if (v1->port1 == v2->port1 &&
-            v1->port2 == v2->port2 &&
-            ADDRESSES_EQUAL(&v1->addr1, &v2->addr1) &&
-            ADDRESSES_EQUAL(&v1->addr2, &v2->addr2)) {
-            return 1;
-        }
-
-        if (v1->port2 == v2->port1 &&
-            v1->port1 == v2->port2 &&
-            ADDRESSES_EQUAL(&v1->addr2, &v2->addr1) &&
-            ADDRESSES_EQUAL(&v1->addr1, &v2->addr2)) {
-            return 1;
-        }
-    }
-
-    /*
-     * The addresses, ports, or conversation IDs don't match.
-     */
-    return 0;
-}
-
-
 void
 add_conversation_table_data(conversations_table *ct, const address *src, const address *dst, guint32 src_port, guint32 dst_port, int num_frames, int num_bytes, nstime_t *ts, SAT_E sat, int port_type_val)
 {
@@ -2939,52 +2878,26 @@ add_conversation_table_data_with_conv_id(
     SAT_E sat,
     int port_type_val)
 {
-    const address *addr1, *addr2;
-    guint32 port1, port2;
+    conv_key_t key;
+    gboolean from_1;
     conv_t *conversation = NULL;
     unsigned int conversation_idx = 0;
 
-    if (src_port > dst_port) {
-        addr1 = src;
-        addr2 = dst;
-        port1 = src_port;
-        port2 = dst_port;
-    } else if (src_port < dst_port) {
-        addr2 = src;
-        addr1 = dst;
-        port2 = src_port;
-        port1 = dst_port;
-    } else if (CMP_ADDRESS(src, dst) < 0) {
-        addr1 = src;
-        addr2 = dst;
-        port1 = src_port;
-        port2 = dst_port;
-    } else {
-        addr2 = src;
-        addr1 = dst;
-        port2 = src_port;
-        port1 = dst_port;
-    }
+    /* Order the ends the same way as the shared conversation table does. */
+    from_1 = conversation_key_init(&key, src, dst, src_port, dst_port, conv_id);
 
     /* if we dont have any entries at all yet */
     if (ct->conversations == NULL) {
         ct->conversations = g_array_sized_new(FALSE, FALSE, sizeof(conv_t), 10000);
 
         ct->hashtable = g_hash_table_new_full(conversation_hash,
-                                              conversation_match, /* key_equal_func */
+                                              conversation_equal, /* key_equal_func */
                                               g_free,             /* key_destroy_func */
                                               NULL);              /* value_destroy_func */
 
     } else {
         /* try to find it among the existing known conversations */
-        conv_key_t existing_key;
-
-        existing_key.addr1 = *addr1;
-        existing_key.addr2 = *addr2;
-        existing_key.port1 = port1;
-        existing_key.port2 = port2;
-        existing_key.conv_id = conv_id;
-        conversation_idx = GPOINTER_TO_UINT(g_hash_table_lookup(ct->hashtable, &existing_key));
+        conversation_idx = GPOINTER_TO_UINT(g_hash_table_lookup(ct->hashtable, &key));
         if (conversation_idx) {
             conversation_idx--;
             conversation=&g_array_index(ct->conversations, conv_t, conversation_idx);
@@ -2997,12 +2910,12 @@ add_conversation_table_data_with_conv_id(
         conv_key_t *new_key;
         conv_t conv;
 
-        COPY_ADDRESS(&conv.src_address, addr1);
-        COPY_ADDRESS(&conv.dst_address, addr2);
+        COPY_ADDRESS(&conv.src_address, &key.addr1);
+        COPY_ADDRESS(&conv.dst_address, &key.addr2);
         conv.sat = sat;
         conv.port_type = port_type_val;
-        conv.src_port = port1;
-        conv.dst_port = port2;
+        conv.src_port = key.port1;
+        conv.dst_port = key.port2;
         conv.conv_id = conv_id;
         conv.rx_frames = 0;
         conv.tx_frames = 0;
@@ -3026,8 +2939,8 @@ add_conversation_table_data_with_conv_id(
         new_key = g_new(conv_key_t, 1);
         SET_ADDRESS(&new_key->addr1, conversation->src_address.type, conversation->src_address.len, conversation->src_address.data);
         SET_ADDRESS(&new_key->addr2, conversation->dst_address.type, conversation->dst_address.len, conversation->dst_address.data);
-        new_key->port1 = port1;
-        new_key->port2 = port2;
+        new_key->port1 = key.port1;
+        new_key->port2 = key.port2;
         new_key->conv_id = conv_id;
         g_hash_table_insert(ct->hashtable, new_key, GUINT_TO_POINTER(conversation_idx +1));
 
@@ -3036,7 +2949,7 @@ add_conversation_table_data_with_conv_id(
 
     /* update the conversation struct */
     conversation->modified = TRUE;
-    if ( (!CMP_ADDRESS(src, addr1)) && (!CMP_ADDRESS(dst, addr2)) && (src_port==port1) && (dst_port==port2) ) {
+    if (from_1) {
         conversation->tx_frames += num_frames;
         conversation->tx_bytes += num_bytes;
     } else {
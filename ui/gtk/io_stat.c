@@ -39,6 +39,7 @@
 
 #include "../stat_menu.h"
 #include "ui/alert_box.h"
+#include "ui/io_graph_item.h"
 #include "ui/simple_dialog.h"
 
 #include "ui/gtk/gtkglobals.h"
@@ -117,30 +118,9 @@ typedef struct _io_stat_calc_type_t {
 	int calc_type;
 } io_stat_calc_type_t;
 
-#define NUM_IO_ITEMS 100000
-typedef struct _io_item_t {
-	guint32 frames; /* always calculated, will hold number of frames*/
-	guint64 bytes;  /* always calculated, will hold number of bytes*/
-	guint64 fields;
-	gint64 int_max;
-	gint64 int_min;
-	gint64 int_tot;
-	gfloat float_max;
-	gfloat float_min;
-	gfloat float_tot;
-	gdouble double_max;
-	gdouble double_min;
-	gdouble double_tot;
-	nstime_t time_max;
-	nstime_t time_min;
-	nstime_t time_tot;
-	guint32 first_frame_in_invl;
-	guint32 last_frame_in_invl;
-} io_item_t;
-
 typedef struct _io_stat_graph_t {
 	struct _io_stat_t *io;
-	gpointer items[NUM_IO_ITEMS];
+	io_graph_store_t *store;	/* counted in 1 ms base intervals */
 	int plot_style;
 	gboolean display;
 	GtkWidget *display_button;
@@ -163,7 +143,7 @@ typedef struct _io_stat_t {
 	guint32 interval;      /* measurement interval in ms */
 	guint32 last_interval; /* the last *displayed* interval */
 	guint32 max_interval;  /* the maximum interval based on the capture duration */
-	guint32 num_items;     /* total number of items in all intervals (zero relative) */
+	guint64 num_items;     /* last interval with data, at the current tick interval (zero relative) */
 	guint32 left_x_border;
 	guint32 right_x_border;
 	gboolean view_as_time;
@@ -206,32 +186,11 @@ io_stat_set_title(io_stat_t *io)
 static void
 io_stat_reset(io_stat_t *io)
 {
-	int i, j;
+	int i;
 
 	io->needs_redraw=TRUE;
 	for(i=0;i<MAX_GRAPHS;i++){
-		for(j=0;j<NUM_IO_ITEMS;j++){
-			io_item_t *ioi;
-			ioi=io->graphs[i].items[j];
-
-			ioi->frames=0;
-			ioi->bytes=0;
-			ioi->fields=0;
-			ioi->int_max=0;
-			ioi->int_min=0;
-			ioi->int_tot=0;
-			ioi->float_max=0;
-			ioi->float_min=0;
-			ioi->float_tot=0;
-			ioi->double_max=0;
-			ioi->double_min=0;
-			ioi->double_tot=0;
-			nstime_set_zero(&ioi->time_max);
-			nstime_set_zero(&ioi->time_min);
-			nstime_set_zero(&ioi->time_tot);
-			ioi->first_frame_in_invl=0;
-			ioi->last_frame_in_invl=0;
-		}
+		io_graph_store_reset(io->graphs[i].store);
 	}
 	io->last_interval=0xffffffff;
 	io->max_interval=0;
@@ -249,14 +208,24 @@ tap_iostat_reset(void *g)
 	io_stat_reset(gio->io);
 }
 
+static void
+add_load_time(io_graph_item_t *item, guint64 us)
+{
+	item->time_tot.nsecs += (int) (us * 1000);
+	if(item->time_tot.nsecs > 1000000000){
+		item->time_tot.secs++;
+		item->time_tot.nsecs -= 1000000000;
+	}
+}
+
 static gboolean
 tap_iostat_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *dummy _U_)
 {
 	io_stat_graph_t *graph = g;
 	io_stat_t *io;
-	io_item_t *it;
+	io_graph_item_t *it;
 	nstime_t time_delta;
-	int idx;
+	guint64 idx;
 
 	/* we sometimes get called when the graph is disabled.
 	   this is a bug since the tap listener should be removed first */
@@ -268,7 +237,8 @@ tap_iostat_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *
 	io->needs_redraw = TRUE;
 
 	/*
-	 * Find in which interval this is supposed to go and store the interval index as idx
+	 * Find in which millisecond this is supposed to go and store its index as idx;
+	 * the store adds them up into whatever tick interval we draw.
 	 */
 	time_delta = pinfo->fd->rel_ts;
 	if(time_delta.nsecs<0){
@@ -278,26 +248,15 @@ tap_iostat_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *
 	if(time_delta.secs<0){
 		return FALSE;
 	}
-	idx = (int) ((time_delta.secs*1000 + time_delta.nsecs/1000000) / io->interval);
-
-	/* some sanity checks */
-	if((idx < 0) || (idx >= NUM_IO_ITEMS)) {
-		io->num_items = NUM_IO_ITEMS-1;
-		return FALSE;
-	}
-
-	/* update num_items */
-	if((guint32)idx > io->num_items){
-		io->num_items = (guint32) idx;
-	}
+	idx = (guint64)time_delta.secs*1000 + time_delta.nsecs/1000000;
 
 	/* set start time */
 	if(io->start_time.secs == 0 && io->start_time.nsecs == 0) {
 		nstime_delta (&io->start_time, &pinfo->fd->abs_ts, &pinfo->fd->rel_ts);
 	}
 
-	/* Point to the appropriate io_item_t struct */
-	it = graph->items[idx];
+	/* Point to the appropriate io_graph_item_t struct */
+	it = io_graph_store_item(graph->store, idx);
 
 	/* Set the first and last frame num in current interval matching the target field+filter  */
 	if (it->first_frame_in_invl == 0) {
@@ -393,44 +352,34 @@ tap_iostat_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *
 				new_time = fvalue_get(&((field_info *)gp->pdata[0])->value);
 
 				switch(graph->calc_type){
-					guint64 t, pt; /* time in us */
-					int j;
+					guint64 t, pt, n, k; /* time in us */
 				case CALC_TYPE_LOAD:
 					/*
-					* Add the time this call spanned each interval according to its contribution
-					* to that interval.
+					* Add the time this call spanned each millisecond according to its contribution
+					* to that millisecond: what it spent in the current one and in the one it
+					* started in, and a span for the whole milliseconds in between.
 					*/
 					t = new_time->secs;
 					t = t * 1000000 + new_time->nsecs / 1000;
-					j = idx;
-					/*
-					 * Handle current interval */
 					pt = pinfo->fd->rel_ts.secs * 1000000 + pinfo->fd->rel_ts.nsecs / 1000;
-					pt = pt % (io->interval * 1000);
+					pt = pt % 1000;
 					if(pt > t) {
 						pt = t;
 					}
-					while(t){
-						io_item_t *item;
-
-						item = (io_item_t*)graph->items[j];
-						item->time_tot.nsecs += (int) (pt * 1000);
-						if(item->time_tot.nsecs > 1000000000){
-							item->time_tot.secs++;
-							item->time_tot.nsecs -= 1000000000;
-						}
-
-						if(j==0){
-							break;
-						}
-						j--;
-						t -= pt;
-						if(t > (guint64) io->interval * 1000) {
-							pt = (guint64) io->interval * 1000;
-						} else {
-							pt = t;
-						}
+					t -= pt;
+					n = (t + 999) / 1000;
+					if(n > 0 && n <= idx){
+						add_load_time(io_graph_store_item(graph->store, idx - n),
+							      t - (n - 1) * 1000);
+						k = idx - n + 1;
+					} else {
+						/* Nothing before this millisecond, or it started before the capture */
+						k = (n > 0) ? 0 : idx;
 					}
+					io_graph_store_add_span(graph->store, k, idx);
+					add_load_time(io_graph_store_item(graph->store, idx), pt);
+					/* That may have moved our own item */
+					it = io_graph_store_item(graph->store, idx);
 					break;
 				default:
 					if( (new_time->secs > it->time_max.secs)
@@ -479,14 +428,14 @@ tap_iostat_packet(void *g, packet_info *pinfo, epan_dissect_t *edt, const void *
 }
 
 static guint64
-get_it_value(io_stat_t *io, int graph, int idx)
+get_it_value(io_stat_t *io, int graph, guint64 idx)
 {
 	guint64 value=0; /* FIXME: loss of precision, visible on the graph for small values */
 	int adv_type;
-	io_item_t *it;
+	io_graph_item_t item, *it = &item;
 	guint32 interval;
 
-	it = io->graphs[graph].items[idx];
+	io_graph_store_get(io->graphs[graph].store, io->interval, idx, it);
 
 	switch(io->count_type){
 	case COUNT_TYPE_FRAMES:
@@ -611,10 +560,10 @@ get_it_value(io_stat_t *io, int graph, int idx)
 			}
 			break;
 		case CALC_TYPE_LOAD:
-			if (idx==(int)io->num_items) {
+			if (idx==io->num_items) {
 				interval = (guint32)((cfile.elapsed_time.secs*1000) +
 					   ((cfile.elapsed_time.nsecs+500000)/1000000));
-				interval -= (io->interval * idx);
+				interval -= (guint32)(io->interval * idx);
 			} else {
 				interval = io->interval;
 			}
@@ -700,7 +649,6 @@ io_stat_draw(io_stat_t *io)
 	char label_string[45];
 	GtkAllocation widget_alloc;
 	/* new variables */
-	guint32 num_time_intervals; /* number of intervals relative to 1 */
 	guint64 max_value;		/* max value of seen data */
 	guint32 max_y;			/* max value of the Y scale */
 	gboolean draw_y_as_time;
@@ -720,28 +668,33 @@ io_stat_draw(io_stat_t *io)
 				     io->interval);
 	io->max_interval = (io->max_interval / io->interval) * io->interval;
 	/*
-	 * Find the length of the intervals we have data for
-	 * so we know how large arrays we need to malloc()
+	 * Find the last interval we have data for at the current tick interval
 	 */
-	num_time_intervals = io->num_items+1;
+	io->num_items=0;
+	for(i=0;i<MAX_GRAPHS;i++){
+		guint64 end;
 
-	/* XXX move this check to _packet() */
-	if(num_time_intervals > NUM_IO_ITEMS){
-		simple_dialog(ESD_TYPE_ERROR, ESD_BTN_OK, "IO-Stat error. There are too many entries, bailing out");
-		return;
+		if(!io->graphs[i].display){
+			continue;
+		}
+		end=io_graph_store_end(io->graphs[i].store);
+		if(end>0 && (end-1)/io->interval > io->num_items){
+			io->num_items=(end-1)/io->interval;
+		}
 	}
 
 	/*
-	 * find the max value so we can autoscale the y axis
+	 * find the max value so we can autoscale the y axis;
+	 * intervals without data can't hold it, so skip them
 	 */
 	max_value=0;
 	for(i=0;i<MAX_GRAPHS;i++){
-		int idx;
+		guint64 idx;
 
 		if(!io->graphs[i].display){
 			continue;
 		}
-		for(idx=0; (guint32)(idx) < num_time_intervals; idx++){
+		for(idx=0; io_graph_store_next(io->graphs[i].store, io->interval, &idx); idx++){
 			guint64 val;
 
 			val=get_it_value(io, i, idx);
@@ -853,24 +806,6 @@ io_stat_draw(io_stat_t *io)
 	draw_width = io->surface_width-io->right_x_border - io->left_x_border;
 	draw_height = io->surface_height-top_y_border - bottom_y_border;
 
-	/*
-	 * Add a warning if too many entries
-	 */
-	if (num_time_intervals >= NUM_IO_ITEMS-1) {
-		g_snprintf (label_string, 45, "Warning: Graph limited to %d entries", NUM_IO_ITEMS);
-		pango_layout_set_text(layout, label_string, -1);
-
-#if GTK_CHECK_VERSION(2,22,0)
-		cr = cairo_create (io->surface);
-#else
-		cr = gdk_cairo_create (io->pixmap);
-#endif
-		cairo_move_to (cr, 5, io->surface_height-bottom_y_border-draw_height-label_height/2);
-		pango_cairo_show_layout (cr, layout);
-		cairo_destroy (cr);
-		cr = NULL;
-	}
-
 	/* Draw the y axis and labels
 	* (we always draw the y scale with 11 ticks along the axis)
 	*/
@@ -1092,18 +1027,18 @@ io_stat_draw(io_stat_t *io)
 			}
 			mavg_to_remove = warmup_interval;
 			for(;warmup_interval<first_interval;warmup_interval+=io->interval){
-				mavg_cumulated += get_it_value(io, i, (int)warmup_interval/io->interval);
+				mavg_cumulated += get_it_value(io, i, warmup_interval/io->interval);
 				mavg_in_average_count++;
 				mavg_left++;
 			}
-			mavg_cumulated += get_it_value(io, i, (int)warmup_interval/io->interval);
+			mavg_cumulated += get_it_value(io, i, warmup_interval/io->interval);
 			mavg_in_average_count++;
 			for(warmup_interval += io->interval;
 			    ((warmup_interval < (first_interval + (io->filter_order/2) * (guint64)io->interval)) &&
-			    (warmup_interval <= (io->num_items * (guint64)io->interval)));
+			    (warmup_interval <= (io->num_items * io->interval)));
 			    warmup_interval += io->interval) {
 
-				mavg_cumulated += get_it_value(io, i, (int)warmup_interval / io->interval);
+				mavg_cumulated += get_it_value(io, i, warmup_interval / io->interval);
 				mavg_in_average_count++;
 				mavg_right++;
 			}
@@ -1150,12 +1085,12 @@ io_stat_draw(io_stat_t *io)
 					if (mavg_left > io->filter_order/2) {
 						mavg_left--;
 						mavg_in_average_count--;
-						mavg_cumulated -= get_it_value(io, i, (int)mavg_to_remove/io->interval);
+						mavg_cumulated -= get_it_value(io, i, mavg_to_remove/io->interval);
 						mavg_to_remove += io->interval;
 					}
-					if (mavg_to_add<=(guint64)io->num_items*io->interval){
+					if (mavg_to_add<=io->num_items*io->interval){
 						mavg_in_average_count++;
-						mavg_cumulated += get_it_value(io, i, (int)mavg_to_add/io->interval);
+						mavg_cumulated += get_it_value(io, i, mavg_to_add/io->interval);
 						mavg_to_add += io->interval;
 					} else {
 						mavg_right--;
@@ -1356,8 +1291,9 @@ enable_graph(io_stat_graph_t *gio, const char *filter, const char *field)
 			g_strlcat(real_filter, field, 262);
 		}
 	}
+	/* the field is primed with the filter, so nothing else is needed */
 	return register_tap_listener("frame", gio, real_filter[0]?real_filter:NULL,
-				     TL_REQUIRES_PROTO_TREE,
+				     TL_REQUIRES_NOTHING,
 				     tap_iostat_reset, tap_iostat_packet, tap_iostat_draw);
 }
 
@@ -1376,7 +1312,7 @@ static void
 iostat_init(const char *optarg _U_, void* userdata _U_)
 {
 	io_stat_t *io;
-	int i=0, j=0;
+	int i=0;
 	static GdkColor col[MAX_GRAPHS] = {
 		{0,	0x0000,	0x0000,	0x0000}, /* Black */
 		{0,	0xffff,	0x0000,	0x0000}, /* Red */
@@ -1446,9 +1382,7 @@ iostat_init(const char *optarg _U_, void* userdata _U_)
 
 		io->graphs[i].filter_bt=NULL;
 
-		for(j=0;j<NUM_IO_ITEMS;j++){
-			io->graphs[i].items[j] = g_new(io_item_t,1);
-		}
+		io->graphs[i].store = io_graph_store_new(1000);
 	}
 	io_stat_reset(io);
 
@@ -1480,7 +1414,7 @@ static void
 draw_area_destroy_cb(GtkWidget *widget _U_, gpointer user_data)
 {
 	io_stat_t *io = user_data;
-	int i,j;
+	int i;
 	GtkWidget *save_bt = g_object_get_data(G_OBJECT(io->window), "save_bt");
 	surface_info_t *surface_info = g_object_get_data(G_OBJECT(save_bt), "surface-info");
 
@@ -1495,11 +1429,9 @@ draw_area_destroy_cb(GtkWidget *widget _U_, gpointer user_data)
 
 			g_free(io->graphs[i].args);
 			io->graphs[i].args=NULL;
-			for(j=0;j<NUM_IO_ITEMS;j++){
-				g_free(io->graphs[i].items[j]);
-				io->graphs[i].items[j]=NULL;
-			}
 		}
+		io_graph_store_free(io->graphs[i].store);
+		io->graphs[i].store=NULL;
 	}
 	g_free(io);
 
@@ -1511,7 +1443,7 @@ pixmap_clicked_event(GtkWidget *widget _U_, GdkEventButton *event, gpointer g)
 {
 	io_stat_t *io = g;
 	io_stat_graph_t *graph;
-	io_item_t *it;
+	io_graph_item_t item, *it = &item;
 	guint32 draw_width, interval, last_interval, frame_num=0;
 	int i;
 	gboolean load=FALSE, outstanding_call=FALSE;
@@ -1556,7 +1488,7 @@ pixmap_clicked_event(GtkWidget *widget _U_, GdkEventButton *event, gpointer g)
 		for(i=0; i<MAX_GRAPHS; i++) {
 			graph = &io->graphs[i];
 			if(graph->display) {
-				it = graph->items[interval];
+				io_graph_store_get(graph->store, io->interval, interval, it);
 				if (event->button==1) {
 					if(frame_num==0 || (it->first_frame_in_invl < frame_num))
 						frame_num = it->first_frame_in_invl;
@@ -1739,9 +1671,9 @@ tick_interval_select(GtkWidget *item, gpointer user_data)
 
 	i = gtk_combo_box_get_active (GTK_COMBO_BOX(item));
 
+	/* The graphs have the counts for every millisecond, so we can
+	   just add them up differently. */
 	io->interval=tick_interval_values[i];
-	cf_retap_packets(&cfile);
-	gdk_window_raise(gtk_widget_get_window(io->window));
 	io_stat_redraw(io);
 }
 
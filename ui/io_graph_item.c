@@ -0,0 +1,434 @@
+/* io_graph_item.c
+ *
+ * $Id$
+ *
+ * Sparse, multi-resolution storage for IO graph statistics.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "ui/io_graph_item.h"
+
+/* Level n of a store holds the sums over 10^n base intervals. */
+#define IO_GRAPH_LEVELS 10
+
+typedef struct {
+    guint64 idx;
+    io_graph_item_t item;
+} io_graph_entry_t;
+
+typedef struct {
+    guint64 idx;
+    guint64 count;  /* number of spans covering all of this interval */
+} io_graph_span_t;
+
+struct _io_graph_store_t {
+    /* Each level is an array of io_graph_entry_t sorted by idx, with
+       no entries for intervals in which nothing was counted.  Level 0
+       is filled in by io_graph_store_item(); the others are built from
+       it on demand. */
+    GArray *levels[IO_GRAPH_LEVELS];
+    int     levels_built;  /* levels below this one are up to date */
+    /* Spans, split into whole intervals of 10^n base intervals; level n
+       is an array of io_graph_span_t sorted by idx. */
+    GArray *spans[IO_GRAPH_LEVELS];
+    guint32 base_us;       /* length of a base interval */
+};
+
+void
+io_graph_item_reset(io_graph_item_t *item)
+{
+    memset(item, 0, sizeof(*item));
+}
+
+void
+io_graph_item_merge(io_graph_item_t *dst, const io_graph_item_t *src)
+{
+    if (src->fields) {
+        if (dst->fields == 0) {
+            dst->int_max = src->int_max;
+            dst->int_min = src->int_min;
+            dst->float_max = src->float_max;
+            dst->float_min = src->float_min;
+            dst->double_max = src->double_max;
+            dst->double_min = src->double_min;
+            dst->time_max = src->time_max;
+            dst->time_min = src->time_min;
+        } else {
+            if (src->int_max > dst->int_max)
+                dst->int_max = src->int_max;
+            if (src->int_min < dst->int_min)
+                dst->int_min = src->int_min;
+            if (src->float_max > dst->float_max)
+                dst->float_max = src->float_max;
+            if (src->float_min < dst->float_min)
+                dst->float_min = src->float_min;
+            if (src->double_max > dst->double_max)
+                dst->double_max = src->double_max;
+            if (src->double_min < dst->double_min)
+                dst->double_min = src->double_min;
+            if (nstime_cmp(&src->time_max, &dst->time_max) > 0)
+                dst->time_max = src->time_max;
+            if (nstime_cmp(&src->time_min, &dst->time_min) < 0)
+                dst->time_min = src->time_min;
+        }
+    }
+
+    dst->frames += src->frames;
+    dst->bytes += src->bytes;
+    dst->fields += src->fields;
+    dst->int_tot += src->int_tot;
+    dst->float_tot += src->float_tot;
+    dst->double_tot += src->double_tot;
+    nstime_add(&dst->time_tot, &src->time_tot);
+
+    if (src->first_frame_in_invl != 0 &&
+        (dst->first_frame_in_invl == 0 || src->first_frame_in_invl < dst->first_frame_in_invl))
+        dst->first_frame_in_invl = src->first_frame_in_invl;
+    if (src->last_frame_in_invl > dst->last_frame_in_invl)
+        dst->last_frame_in_invl = src->last_frame_in_invl;
+}
+
+io_graph_store_t *
+io_graph_store_new(guint32 base_us)
+{
+    io_graph_store_t *store = g_new(io_graph_store_t, 1);
+    int i;
+
+    for (i = 0; i < IO_GRAPH_LEVELS; i++) {
+        store->levels[i] = g_array_new(FALSE, FALSE, sizeof(io_graph_entry_t));
+        store->spans[i] = g_array_new(FALSE, FALSE, sizeof(io_graph_span_t));
+    }
+    store->levels_built = 1;
+    store->base_us = base_us;
+    return store;
+}
+
+void
+io_graph_store_reset(io_graph_store_t *store)
+{
+    int i;
+
+    for (i = 0; i < IO_GRAPH_LEVELS; i++) {
+        g_array_set_size(store->levels[i], 0);
+        g_array_set_size(store->spans[i], 0);
+    }
+    store->levels_built = 1;
+}
+
+void
+io_graph_store_free(io_graph_store_t *store)
+{
+    int i;
+
+    if (!store)
+        return;
+    for (i = 0; i < IO_GRAPH_LEVELS; i++) {
+        g_array_free(store->levels[i], TRUE);
+        g_array_free(store->spans[i], TRUE);
+    }
+    g_free(store);
+}
+
+/* Index of the first entry of a level whose idx is >= idx */
+static guint
+io_graph_level_find(const GArray *level, guint64 idx)
+{
+    guint lo = 0, hi = level->len, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (g_array_index(level, io_graph_entry_t, mid).idx < idx)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Index of the first span of a level whose idx is >= idx */
+static guint
+io_graph_spans_find(const GArray *spans, guint64 idx)
+{
+    guint lo = 0, hi = spans->len, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (g_array_index(spans, io_graph_span_t, mid).idx < idx)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+io_graph_item_t *
+io_graph_store_item(io_graph_store_t *store, guint64 idx)
+{
+    GArray *level = store->levels[0];
+    io_graph_entry_t entry, *last;
+    guint pos;
+
+    store->levels_built = 1;
+
+    /* Packets mostly arrive in time order, so this is usually the last
+       entry or a new one after it. */
+    if (level->len > 0) {
+        last = &g_array_index(level, io_graph_entry_t, level->len - 1);
+        if (last->idx == idx)
+            return &last->item;
+        if (last->idx > idx) {
+            pos = io_graph_level_find(level, idx);
+            if (g_array_index(level, io_graph_entry_t, pos).idx != idx) {
+                entry.idx = idx;
+                io_graph_item_reset(&entry.item);
+                g_array_insert_val(level, pos, entry);
+            }
+            return &g_array_index(level, io_graph_entry_t, pos).item;
+        }
+    }
+
+    entry.idx = idx;
+    io_graph_item_reset(&entry.item);
+    g_array_append_val(level, entry);
+    return &g_array_index(level, io_graph_entry_t, level->len - 1).item;
+}
+
+void
+io_graph_store_add_span(io_graph_store_t *store, guint64 start, guint64 end)
+{
+    GArray *spans;
+    io_graph_span_t span, *last;
+    guint64 size;
+    guint pos;
+    int n;
+
+    /* Cover [start, end) with the largest aligned intervals we can,
+       so that a long span takes at most 18 entries per level. */
+    while (start < end) {
+        n = 0;
+        size = 1;
+        while (n < IO_GRAPH_LEVELS - 1 && start % (size * 10) == 0 &&
+               end - start >= size * 10) {
+            size *= 10;
+            n++;
+        }
+
+        spans = store->spans[n];
+        span.idx = start / size;
+        span.count = 1;
+        /* Spans mostly end in time order, so this usually appends. */
+        if (spans->len > 0) {
+            last = &g_array_index(spans, io_graph_span_t, spans->len - 1);
+            if (last->idx == span.idx) {
+                last->count++;
+            } else if (last->idx > span.idx) {
+                pos = io_graph_spans_find(spans, span.idx);
+                if (g_array_index(spans, io_graph_span_t, pos).idx == span.idx)
+                    g_array_index(spans, io_graph_span_t, pos).count++;
+                else
+                    g_array_insert_val(spans, pos, span);
+            } else {
+                g_array_append_val(spans, span);
+            }
+        } else {
+            g_array_append_val(spans, span);
+        }
+        start += size;
+    }
+}
+
+guint64
+io_graph_store_end(const io_graph_store_t *store)
+{
+    const GArray *level = store->levels[0];
+    const GArray *spans;
+    guint64 end = 0, span_end, size = 1;
+    int n;
+
+    if (level->len > 0)
+        end = g_array_index(level, io_graph_entry_t, level->len - 1).idx + 1;
+    for (n = 0; n < IO_GRAPH_LEVELS; n++, size *= 10) {
+        spans = store->spans[n];
+        if (spans->len == 0)
+            continue;
+        span_end = (g_array_index(spans, io_graph_span_t, spans->len - 1).idx + 1) * size;
+        if (span_end > end)
+            end = span_end;
+    }
+    return end;
+}
+
+/* Get a level, summing up the one below it first if need be */
+static GArray *
+io_graph_store_level(io_graph_store_t *store, int n)
+{
+    GArray *level, *below;
+    io_graph_entry_t *entry, *last;
+    guint i;
+
+    while (store->levels_built <= n) {
+        below = store->levels[store->levels_built - 1];
+        level = store->levels[store->levels_built];
+        g_array_set_size(level, 0);
+        last = NULL;
+        for (i = 0; i < below->len; i++) {
+            entry = &g_array_index(below, io_graph_entry_t, i);
+            if (last == NULL || last->idx != entry->idx / 10) {
+                g_array_append_val(level, *entry);
+                last = &g_array_index(level, io_graph_entry_t, level->len - 1);
+                last->idx = entry->idx / 10;
+            } else {
+                io_graph_item_merge(&last->item, &entry->item);
+            }
+        }
+        store->levels_built++;
+    }
+    return store->levels[n];
+}
+
+/* Pick the coarsest level whose intervals evenly divide intervals of
+   the given width, and say how many of them make up one. */
+static GArray *
+io_graph_store_level_for(io_graph_store_t *store, guint32 width, guint32 *count)
+{
+    int n = 0;
+
+    if (width == 0)
+        width = 1;
+    while (n < IO_GRAPH_LEVELS - 1 && width % 10 == 0) {
+        width /= 10;
+        n++;
+    }
+    *count = width;
+    return io_graph_store_level(store, n);
+}
+
+gboolean
+io_graph_store_get(io_graph_store_t *store, guint32 width, guint64 idx,
+                   io_graph_item_t *item)
+{
+    GArray *level;
+    guint32 count;
+    guint pos;
+    io_graph_entry_t *entry;
+    gboolean found = FALSE;
+
+    GArray *spans;
+    io_graph_span_t *span;
+    guint64 start, end, size, from, to, covered = 0;
+    nstime_t span_time;
+    int n;
+
+    io_graph_item_reset(item);
+    level = io_graph_store_level_for(store, width, &count);
+    for (pos = io_graph_level_find(level, idx * count); pos < level->len; pos++) {
+        entry = &g_array_index(level, io_graph_entry_t, pos);
+        if (entry->idx / count != idx)
+            break;
+        io_graph_item_merge(item, &entry->item);
+        found = TRUE;
+    }
+
+    /* Add the part of each span that falls within the interval */
+    if (width == 0)
+        width = 1;
+    start = idx * width;
+    end = start + width;
+    for (n = 0, size = 1; n < IO_GRAPH_LEVELS; n++, size *= 10) {
+        spans = store->spans[n];
+        for (pos = io_graph_spans_find(spans, start / size); pos < spans->len; pos++) {
+            span = &g_array_index(spans, io_graph_span_t, pos);
+            from = span->idx * size;
+            if (from >= end)
+                break;
+            to = from + size;
+            if (from < start)
+                from = start;
+            if (to > end)
+                to = end;
+            covered += (to - from) * span->count;
+        }
+    }
+    if (covered) {
+        covered *= store->base_us;
+        span_time.secs = (time_t)(covered / 1000000);
+        span_time.nsecs = (int)(covered % 1000000) * 1000;
+        nstime_add(&item->time_tot, &span_time);
+        found = TRUE;
+    }
+    return found;
+}
+
+gboolean
+io_graph_store_next(io_graph_store_t *store, guint32 width, guint64 *idx)
+{
+    GArray *level;
+    guint32 count;
+    guint pos;
+
+    GArray *spans;
+    guint64 start, size, from, next = G_MAXUINT64;
+    int n;
+
+    level = io_graph_store_level_for(store, width, &count);
+    pos = io_graph_level_find(level, *idx * count);
+    if (pos < level->len)
+        next = g_array_index(level, io_graph_entry_t, pos).idx / count;
+
+    /* An interval that a span covers part of isn't empty either */
+    if (width == 0)
+        width = 1;
+    start = *idx * width;
+    for (n = 0, size = 1; n < IO_GRAPH_LEVELS; n++, size *= 10) {
+        spans = store->spans[n];
+        pos = io_graph_spans_find(spans, start / size);
+        if (pos == spans->len)
+            continue;
+        from = g_array_index(spans, io_graph_span_t, pos).idx * size;
+        if (from < start)
+            from = start;
+        if (from / width < next)
+            next = from / width;
+    }
+
+    if (next == G_MAXUINT64)
+        return FALSE;
+    *idx = next;
+    return TRUE;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
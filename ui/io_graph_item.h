@@ -0,0 +1,165 @@
+/* io_graph_item.h
+ *
+ * $Id$
+ *
+ * Sparse, multi-resolution storage for IO graph statistics.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __IO_GRAPH_ITEM_H__
+#define __IO_GRAPH_ITEM_H__
+
+#include <epan/nstime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** The statistics gathered for one interval of an IO graph. */
+typedef struct _io_graph_item_t {
+    guint32 frames; /* always calculated, will hold number of frames*/
+    guint64 bytes;  /* always calculated, will hold number of bytes*/
+    guint64 fields;
+    gint64 int_max;
+    gint64 int_min;
+    gint64 int_tot;
+    gfloat float_max;
+    gfloat float_min;
+    gfloat float_tot;
+    gdouble double_max;
+    gdouble double_min;
+    gdouble double_tot;
+    nstime_t time_max;
+    nstime_t time_min;
+    nstime_t time_tot;
+    guint32 first_frame_in_invl;
+    guint32 last_frame_in_invl;
+} io_graph_item_t;
+
+/** Reset an item to the empty state.
+ *
+ * @param item The item to reset.
+ */
+extern void io_graph_item_reset(io_graph_item_t *item);
+
+/** Fold the statistics of one item into another, as if the packets
+ * counted in src had been counted in dst.
+ *
+ * @param dst The item to add to.
+ * @param src The item to add.
+ */
+extern void io_graph_item_merge(io_graph_item_t *dst, const io_graph_item_t *src);
+
+/** Items for the intervals of one graph.
+ *
+ * Packets are counted in "base intervals" whose length is up to the
+ * caller; only base intervals that something was counted in take up
+ * memory.  The statistics can then be read back for any interval that
+ * is a whole number of base intervals long, without counting the
+ * packets again: sums over 10, 100, 1000... base intervals are built
+ * when first asked for and kept until more packets are counted.
+ *
+ * A store can also hold spans of time covering many base intervals,
+ * e.g. the durations of calls, without an item for each of them.
+ */
+typedef struct _io_graph_store_t io_graph_store_t;
+
+/** Create an empty store.
+ *
+ * @param base_us The length of a base interval, in microseconds; only
+ * used to turn spans into time.
+ * @return The new store. Must be freed with io_graph_store_free().
+ */
+extern io_graph_store_t *io_graph_store_new(guint32 base_us);
+
+/** Discard everything counted in a store.
+ *
+ * @param store The store.
+ */
+extern void io_graph_store_reset(io_graph_store_t *store);
+
+/** Free a store and everything in it.
+ *
+ * @param store The store.
+ */
+extern void io_graph_store_free(io_graph_store_t *store);
+
+/** Get the item of a base interval to count a packet in, creating an
+ * empty one if need be.
+ *
+ * @param store The store.
+ * @param idx The number of the base interval.
+ * @return The item. It is only valid until the next call to this
+ * function.
+ */
+extern io_graph_item_t *io_graph_store_item(io_graph_store_t *store, guint64 idx);
+
+/** Count a span of time that covers whole base intervals.
+ *
+ * io_graph_store_get() adds the part of the span that falls within an
+ * interval to the interval's time_tot.  The span is kept as a handful of
+ * entries per power of ten of its length, not one per base interval.
+ *
+ * @param store The store.
+ * @param start The number of the first base interval covered.
+ * @param end The number of the base interval after the last one covered.
+ */
+extern void io_graph_store_add_span(io_graph_store_t *store, guint64 start,
+                                    guint64 end);
+
+/** Get the number of base intervals up to and including the last one
+ * with an item or span.
+ *
+ * @param store The store.
+ * @return One more than the number of the last base interval with an
+ * item or covered by a span, or 0 if the store is empty.
+ */
+extern guint64 io_graph_store_end(const io_graph_store_t *store);
+
+/** Get the statistics of an interval.
+ *
+ * @param store The store.
+ * @param width The length of the interval, in base intervals.
+ * @param idx The number of the interval; it starts at base interval
+ * idx * width.
+ * @param[out] item Filled in with the statistics of the interval.
+ * @return TRUE if anything was counted in the interval.
+ */
+extern gboolean io_graph_store_get(io_graph_store_t *store, guint32 width,
+                                   guint64 idx, io_graph_item_t *item);
+
+/** Find the first interval, at or after a given one, that anything
+ * was counted in or that a span covers part of.
+ *
+ * @param store The store.
+ * @param width The length of the intervals, in base intervals.
+ * @param[in,out] idx The number of the interval to start at; set to the
+ * number of the interval found.
+ * @return TRUE if an interval was found, FALSE if there is nothing at or
+ * after *idx.
+ */
+extern gboolean io_graph_store_next(io_graph_store_t *store, guint32 width,
+                                    guint64 *idx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __IO_GRAPH_ITEM_H__ */
@@ -304,6 +304,7 @@ void PacketList::selectionChanged (const QItemSelection & selected, const QItemS
 
 // Redraw the packet list and detail
 void PacketList::updateAll() {
+    packet_list_model_->invalidateCache();
     update();
 
     if (selectedIndexes().length() > 0) {
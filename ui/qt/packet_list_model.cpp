@@ -37,11 +37,25 @@
 
 #include <QColor>
 
+// Upper bound for the column text we keep around.
+#define PACKET_LIST_CACHE_BYTES (32 * 1024 * 1024)
+// How many rows past the last one shown we dissect in the background,
+// and how many of those we dissect before giving the event loop a turn.
+#define PACKET_LIST_DISSECT_AHEAD 500
+#define PACKET_LIST_DISSECT_BATCH 50
 
 PacketListModel::PacketListModel(QObject *parent, capture_file *cfPtr) :
-    QAbstractItemModel(parent)
+    QAbstractItemModel(parent),
+    enable_color_(false),
+    lru_head_(NULL),
+    lru_tail_(NULL),
+    cache_bytes_(0),
+    dissect_ahead_row_(0),
+    dissect_ahead_end_(0)
 {
     cf = cfPtr;
+    dissect_ahead_timer_.setSingleShot(true);
+    connect(&dissect_ahead_timer_, SIGNAL(timeout()), this, SLOT(dissectAhead()));
 }
 
 // Packet list records have no children (for now, at least).
@@ -84,10 +98,13 @@ guint PacketListModel::recreateVisibleRows()
 
 void PacketListModel::setColorEnabled(bool enable_color) {
     enable_color_ = enable_color;
+    invalidateCache();
 }
 
 void PacketListModel::clear() {
     beginResetModel();
+    clearCache();
+    qDeleteAll(physical_rows_);
     physical_rows_.clear();
     visible_rows_.clear();
     endResetModel();
@@ -119,6 +136,11 @@ QVariant PacketListModel::data(const QModelIndex &index, int role) const
     if (!fdata)
         return QVariant();
 
+    // The color filter is set when the record is dissected.
+    if ((role == Qt::BackgroundRole || role == Qt::ForegroundRole) &&
+            enable_color_ && !record->isColorized())
+        cacheRecord(record);
+
     switch (role) {
     case Qt::FontRole:
         return get_monospace_font();
@@ -162,83 +184,104 @@ QVariant PacketListModel::data(const QModelIndex &index, int role) const
     if (col_num > cf->cinfo.num_cols)
         return QVariant();
 
-    epan_dissect_t edt;
-    column_info *cinfo;
-    gboolean create_proto_tree;
-    struct wtap_pkthdr phdr; /* Packet header */
-    guint8 pd[WTAP_MAX_PACKET_SIZE];  /* Packet data */
-    gboolean dissect_columns = TRUE; // XXX - Currently only a placeholder
-
-    if (dissect_columns)
-        cinfo = &cf->cinfo;
-    else
-        cinfo = NULL;
-
-    if (!cf_read_frame_r(cf, fdata, &phdr, pd)) {
-        /*
-         * Error reading the frame.
-         *
-         * Don't set the color filter for now (we might want
-         * to colorize it in some fashion to warn that the
-         * row couldn't be filled in or colorized), and
-         * set the columns to placeholder values, except
-         * for the Info column, where we'll put in an
-         * error message.
-         */
-        if (dissect_columns) {
-            col_fill_in_error(cinfo, fdata, FALSE, FALSE /* fill_fd_columns */);
-
-            //            for(gint col = 0; col < cinfo->num_cols; ++col) {
-            //                /* Skip columns based on frame_data because we already store those. */
-            //                if (!col_based_on_frame_data(cinfo, col))
-            //                    packet_list_change_record(packet_list, record->physical_pos, col, cinfo);
-            //            }
-            //            record->columnized = TRUE;
-        }
-        if (enable_color_) {
-            fdata->color_filter = NULL;
-            //            record->colorized = TRUE;
-        }
-        return QVariant();	/* error reading the frame */
+    if (!record->isColumnized()) {
+        // The view usually asks for the rows below this one next.
+        dissect_ahead_row_ = index.row() + 1;
+        dissect_ahead_end_ = dissect_ahead_row_ + PACKET_LIST_DISSECT_AHEAD;
+        if (!dissect_ahead_timer_.isActive())
+            dissect_ahead_timer_.start(0);
     }
+    cacheRecord(record);
 
-    create_proto_tree = (color_filters_used() && enable_color_) ||
-                        (have_custom_cols(cinfo) && dissect_columns);
+    return record->data(col_num, &cf->cinfo);
+}
 
-    epan_dissect_init(&edt,
-                      create_proto_tree,
-                      FALSE /* proto_tree_visible */);
+// Dissect the record if its column text isn't cached, and mark it as the
+// most recently used one. If the cache grows past its budget we forget the
+// least recently used records; they will be dissected again if needed.
+void PacketListModel::cacheRecord(PacketListRecord *record) const
+{
+    bool need_dissect = !record->isColumnized() || (enable_color_ && !record->isColorized());
 
-    if (enable_color_)
-        color_filters_prime_edt(&edt);
-    if (dissect_columns)
-        col_custom_prime_edt(&edt, cinfo);
+    if (!need_dissect && record == lru_head_)
+        return;
 
-    epan_dissect_run(&edt, &phdr, pd, fdata, cinfo);
+    if (record->isColumnized()) {
+        lruUnlink(record);
+        if (need_dissect)
+            cache_bytes_ -= record->cache_size;
+    }
+    if (need_dissect)
+        cache_bytes_ += record->dissect(cf, enable_color_);
+
+    record->lru_prev = NULL;
+    record->lru_next = lru_head_;
+    if (lru_head_)
+        lru_head_->lru_prev = record;
+    lru_head_ = record;
+    if (!lru_tail_)
+        lru_tail_ = record;
+
+    while (cache_bytes_ > PACKET_LIST_CACHE_BYTES && lru_tail_ != record) {
+        PacketListRecord *victim = lru_tail_;
+        lruUnlink(victim);
+        cache_bytes_ -= victim->cache_size;
+        victim->clearColumns();
+    }
+}
 
-    if (enable_color_)
-        fdata->color_filter = color_filters_colorize_packet(&edt);
+void PacketListModel::lruUnlink(PacketListRecord *record) const
+{
+    if (record->lru_prev)
+        record->lru_prev->lru_next = record->lru_next;
+    else if (lru_head_ == record)
+        lru_head_ = record->lru_next;
+    if (record->lru_next)
+        record->lru_next->lru_prev = record->lru_prev;
+    else if (lru_tail_ == record)
+        lru_tail_ = record->lru_prev;
+    record->lru_prev = record->lru_next = NULL;
+}
 
-    if (dissect_columns) {
-        /* "Stringify" non frame_data vals */
-        epan_dissect_fill_in_columns(&edt, FALSE, FALSE /* fill_fd_columns */);
+// Forget the column text and colors of every packet, e.g. because a
+// packet's comment changed or color filters were applied; the rows will
+// be dissected again as they are shown.
+void PacketListModel::invalidateCache()
+{
+    clearCache();
+    foreach (PacketListRecord *record, physical_rows_) {
+        record->resetColorized();
+    }
+}
 
-        //            for(col = 0; col < cinfo->num_cols; ++col) {
-        //                    /* Skip columns based on frame_data because we already store those. */
-        //                    if (!col_based_on_frame_data(cinfo, col))
-        //                            packet_list_change_record(packet_list, record->physical_pos, col, cinfo);
-        //            }
-//        g_log(NULL, G_LOG_LEVEL_DEBUG, "d_c %d: %s", col_num, cinfo->col_data[col_num]);
+void PacketListModel::clearCache()
+{
+    dissect_ahead_timer_.stop();
+    dissect_ahead_row_ = dissect_ahead_end_ = 0;
+    while (lru_head_) {
+        PacketListRecord *record = lru_head_;
+        lruUnlink(record);
+        record->clearColumns();
     }
+    cache_bytes_ = 0;
+}
 
-    //    if (dissect_columns)
-    //            record->columnized = TRUE;
-    //    if (enable_color_)
-    //            record->colorized = TRUE;
+// Dissection isn't thread safe, so instead of using a worker thread we
+// fill in the rows just past the visible ones a batch at a time whenever
+// the event loop is idle.
+void PacketListModel::dissectAhead()
+{
+    int batch_end = qMin(dissect_ahead_row_ + PACKET_LIST_DISSECT_BATCH,
+                         qMin(dissect_ahead_end_, visible_rows_.count()));
 
-    epan_dissect_cleanup(&edt);
+    for (; dissect_ahead_row_ < batch_end; dissect_ahead_row_++) {
+        PacketListRecord *record = visible_rows_[dissect_ahead_row_];
+        if (!record->isColumnized())
+            cacheRecord(record);
+    }
 
-    return record->data(col_num, cinfo);
+    if (dissect_ahead_row_ < qMin(dissect_ahead_end_, visible_rows_.count()))
+        dissect_ahead_timer_.start(0);
 }
 
 QVariant PacketListModel::headerData(int section, Qt::Orientation orientation,
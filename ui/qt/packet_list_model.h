@@ -34,6 +34,7 @@
 
 #include <QAbstractItemModel>
 #include <QFont>
+#include <QTimer>
 #include <QVector>
 
 #include "packet_list_record.h"
@@ -51,6 +52,7 @@ public:
     guint recreateVisibleRows();
     void setColorEnabled(bool enable_color);
     void clear();
+    void invalidateCache();
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     int columnCount(const QModelIndex &parent = QModelIndex()) const;
@@ -67,6 +69,9 @@ signals:
 
 public slots:
 
+private slots:
+    void dissectAhead();
+
 private:
     capture_file *cf;
     QList<QString> col_names_;
@@ -76,6 +81,19 @@ private:
 
     int header_height_;
     bool enable_color_;
+
+    // Columnized records, most recently used first.
+    mutable PacketListRecord *lru_head_;
+    mutable PacketListRecord *lru_tail_;
+    mutable int cache_bytes_;
+    // Rows we still want to dissect before they are shown.
+    mutable int dissect_ahead_row_;
+    mutable int dissect_ahead_end_;
+    mutable QTimer dissect_ahead_timer_;
+
+    void cacheRecord(PacketListRecord *record) const;
+    void lruUnlink(PacketListRecord *record) const;
+    void clearCache();
 };
 
 #endif // PACKET_LIST_MODEL_H
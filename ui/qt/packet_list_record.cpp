@@ -23,8 +23,22 @@
 
 #include "packet_list_record.h"
 
+#include <epan/epan_dissect.h>
+#include <epan/column.h>
+
+#include "color.h"
+#include "color_filters.h"
+#include "file.h"
+
 PacketListRecord::PacketListRecord(frame_data *frameData) :
-    col_text(NULL), col_text_len(NULL), fdata(frameData)
+    fdata(frameData),
+    columnized(FALSE),
+    colorized(FALSE),
+    physical_pos(0),
+    visible_pos(-1),
+    lru_prev(NULL),
+    lru_next(NULL),
+    cache_size(0)
 {
 }
 
@@ -35,19 +49,98 @@ QVariant PacketListRecord::data(int col_num, column_info *cinfo) const
     if (!cinfo)
         return QVariant();
 
-    if (col_based_on_frame_data(cinfo, col_num)) //{
+    if (col_based_on_frame_data(cinfo, col_num)) {
         col_fill_in_frame_data(fdata, cinfo, col_num, FALSE);
         return cinfo->col_data[col_num];
-//    } else {
-//        QString unknown;
-//        return unknown.sprintf("Unknown: frame %d col %d", fdata->num, col_num);
-//    }
+    }
+
+    if (!columnized || col_num >= col_text.size())
+        return QVariant();
+
+    return col_text[col_num];
 }
 
 frame_data *PacketListRecord::getFdata() {
     return fdata;
 }
 
+int PacketListRecord::dissect(capture_file *cap_file, bool dissect_color)
+{
+    epan_dissect_t edt;
+    column_info *cinfo = &cap_file->cinfo;
+    gboolean create_proto_tree;
+    struct wtap_pkthdr phdr; /* Packet header */
+    guint8 pd[WTAP_MAX_PACKET_SIZE];  /* Packet data */
+    int col;
+
+    g_assert(fdata);
+
+    if (!cf_read_frame_r(cap_file, fdata, &phdr, pd)) {
+        /*
+         * Error reading the frame.
+         *
+         * Don't set the color filter for now (we might want
+         * to colorize it in some fashion to warn that the
+         * row couldn't be filled in or colorized), and
+         * set the columns to placeholder values, except
+         * for the Info column, where we'll put in an
+         * error message.
+         */
+        col_fill_in_error(cinfo, fdata, FALSE, FALSE /* fill_fd_columns */);
+        if (dissect_color) {
+            fdata->color_filter = NULL;
+            colorized = TRUE;
+        }
+    } else {
+        create_proto_tree = (color_filters_used() && dissect_color) ||
+                            have_custom_cols(cinfo);
+
+        epan_dissect_init(&edt,
+                          create_proto_tree,
+                          FALSE /* proto_tree_visible */);
+
+        if (dissect_color)
+            color_filters_prime_edt(&edt);
+        col_custom_prime_edt(&edt, cinfo);
+
+        epan_dissect_run(&edt, &phdr, pd, fdata, cinfo);
+
+        if (dissect_color) {
+            fdata->color_filter = color_filters_colorize_packet(&edt);
+            colorized = TRUE;
+        }
+
+        /* "Stringify" non frame_data vals */
+        epan_dissect_fill_in_columns(&edt, FALSE, FALSE /* fill_fd_columns */);
+
+        epan_dissect_cleanup(&edt);
+    }
+
+    /* Columns based on frame_data are cheap to fill in on demand, so
+     * we only keep the text of the others. */
+    col_text.clear();
+    cache_size = sizeof(*this);
+    for (col = 0; col < cinfo->num_cols; col++) {
+        if (col_based_on_frame_data(cinfo, col)) {
+            col_text << QString();
+        } else {
+            col_text << QString(cinfo->col_data[col]);
+            cache_size += col_text.last().size() * sizeof(QChar);
+        }
+        cache_size += sizeof(QString);
+    }
+    columnized = TRUE;
+
+    return cache_size;
+}
+
+void PacketListRecord::clearColumns()
+{
+    col_text.clear();
+    columnized = FALSE;
+    cache_size = 0;
+}
+
 /*
  * Editor modelines
  *
@@ -31,21 +31,39 @@
 #include <epan/column_info.h>
 #include <epan/packet.h>
 
+#include "cfile.h"
+
 #include <QList>
+#include <QStringList>
 #include <QVariant>
 
 class PacketListRecord
 {
+    friend class PacketListModel;
+
 public:
     PacketListRecord(frame_data *frameData);
     QVariant data(int col_num, column_info *cinfo) const;
     frame_data *getFdata();
 
+    /** Dissect the packet and cache its column text and, if dissect_color
+     * is set, its color filter.
+     *
+     * @param cap_file The capture file the packet belongs to.
+     * @param dissect_color Colorize the packet as well.
+     * @return The approximate number of bytes used by the cached text.
+     */
+    int dissect(capture_file *cap_file, bool dissect_color);
+    /** Forget the cached column text. */
+    void clearColumns();
+    bool isColumnized() const { return columnized; }
+    bool isColorized() const { return colorized; }
+    /** Have the packet colorized again the next time it's dissected. */
+    void resetColorized() { colorized = FALSE; }
+
 private:
-    /** The column text for some columns */
-    gchar **col_text;
-    /**< The length of the column text strings in 'col_text' */
-    guint *col_text_len;
+    /** The column text for the columns not based on frame_data */
+    QStringList col_text;
 
     frame_data *fdata;
 
@@ -59,7 +77,11 @@ private:
     guint physical_pos;
     /** position within the visible array */
     gint visible_pos;
-
+    /** neighbours in the model's least recently used list of columnized records */
+    PacketListRecord *lru_prev;
+    PacketListRecord *lru_next;
+    /** bytes accounted to this record in the model's cache */
+    int cache_size;
 };
 
 #endif // PACKET_LIST_RECORD_H
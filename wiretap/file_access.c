@@ -352,6 +352,8 @@ wtap* wtap_open_offline(const char *filename, int *err, char **err_info,
 
 		file_set_random_access(wth->fh, FALSE, wth->fast_seek);
 		file_set_random_access(wth->random_fh, TRUE, wth->fast_seek);
+		if (!use_stdin)
+			wth->fast_seek_complete = file_seek_index_load(wth->fast_seek, filename);
 	}
 
 	/* Try all file types */
@@ -398,6 +400,10 @@ wtap* wtap_open_offline(const char *filename, int *err, char **err_info,
 	return NULL;
 
 success:
+	/* If we have to build the fast seek index, maybe save it when done. */
+	if (wth->fast_seek != NULL && !wth->fast_seek_complete)
+		wth->fast_seek_save_path = g_strdup(filename);
+
 	wth->frame_buffer = (struct Buffer *)g_malloc(sizeof(struct Buffer));
 	buffer_init(wth->frame_buffer, 1500);
 
@@ -49,10 +49,16 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif /* HAVE_FCNTL_H */
 #include <string.h>
+#ifdef HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif /* HAVE_MMAP */
 #include "wtap-int.h"
 #include "file_wrappers.h"
 #include <wsutil/file_util.h>
@@ -137,8 +143,20 @@ struct wtap_reader {
 	/* fast seeking */
 	GPtrArray *fast_seek;
 	void *fast_seek_cur;
+#ifdef HAVE_MMAP
+	/* uncompressed file mapped into memory */
+	unsigned char *map;     /* start of the mapping, or NULL */
+	gint64 map_size;        /* size of the mapping */
+	gboolean map_failed;    /* TRUE if we shouldn't try to map the file */
+#endif
 };
 
+#ifdef HAVE_MMAP
+#define FILE_IS_MAPPED(state)	((state)->map != NULL)
+#else
+#define FILE_IS_MAPPED(state)	FALSE
+#endif
+
 /* values for wtap_reader compression */
 #define UNKNOWN		0	/* look for a gzip header */
 #define UNCOMPRESSED	1	/* copy input directly */
@@ -170,6 +188,83 @@ raw_read(FILE_T state, unsigned char *buf, unsigned int count, unsigned *have)
 	return 0;
 }
 
+#ifdef HAVE_MMAP
+/*
+ * If an uncompressed file is a regular file, map it into memory and hand
+ * out the data directly from the mapping, rather than read()ing it into
+ * the output buffer.  That saves a copy and a system call for every
+ * buffer's worth of data, and turns seeking within the file into pointer
+ * arithmetic.
+ *
+ * While the file is mapped, raw_pos is the only record of where we are;
+ * the descriptor's offset isn't kept up to date, so anything that read()s
+ * from it must seek it first.
+ */
+static void
+file_map(FILE_T state)
+{
+	ws_statb64 statb;
+	void *map;
+
+	if (state->map != NULL || state->map_failed)
+		return;
+
+	/* Whatever happens, only try once. */
+	state->map_failed = TRUE;
+	if (ws_fstat64(state->fd, &statb) == -1 || !S_ISREG(statb.st_mode))
+		return;
+	if (statb.st_size <= 0 || (guint64)statb.st_size > G_MAXSIZE)
+		return;
+	map = mmap(NULL, (size_t)statb.st_size, PROT_READ, MAP_SHARED,
+	    state->fd, 0);
+	if (map == MAP_FAILED)
+		return;
+	state->map = (unsigned char *)map;
+	state->map_size = statb.st_size;
+	state->map_failed = FALSE;
+}
+
+static void
+file_unmap(FILE_T state)
+{
+	if (state->map == NULL)
+		return;
+
+	/* Give back any data from the mapping that hasn't been delivered
+	   yet; it'll be read() again if it's wanted. */
+	if (state->have != 0 && state->next >= state->map &&
+	    state->next < state->map + state->map_size) {
+		state->raw_pos -= state->have;
+		state->have = 0;
+	}
+	munmap(state->map, (size_t)state->map_size);
+	state->map = NULL;
+	state->map_size = 0;
+	state->map_failed = TRUE;
+}
+
+/*
+ * If another process truncates the file, touching the mapping past the
+ * new end raises SIGBUS rather than giving a short read.  That's rare
+ * enough that we don't pay for an fstat() on every refill; we check when
+ * we get to the end of the mapping, where we'd otherwise go on to read()
+ * past it, and go back to read() for good if the file has shrunk.
+ */
+static gboolean
+file_map_shrunk(FILE_T state)
+{
+	ws_statb64 statb;
+
+	if (ws_fstat64(state->fd, &statb) == 0 && statb.st_size >= state->map_size)
+		return FALSE;
+	file_unmap(state);
+	return TRUE;
+}
+
+/* Largest amount of the mapping we hand out at once; "have" is unsigned */
+#define MAP_CHUNK	(1U << 30)
+#endif /* HAVE_MMAP */
+
 static int /* gz_avail */
 fill_in_buffer(FILE_T state)
 {
@@ -688,6 +783,9 @@ gz_head(FILE_T state)
 		state->avail_in = 0;
 	}
 	state->compression = UNCOMPRESSED;
+#ifdef HAVE_MMAP
+	file_map(state);
+#endif
 	return 0;
 }
 
@@ -701,6 +799,28 @@ fill_out_buffer(FILE_T state)
 			return 0;
 	}
 	if (state->compression == UNCOMPRESSED) {           /* straight copy */
+#ifdef HAVE_MMAP
+		if (state->map != NULL) {
+			if (state->raw_pos < state->map_size) {
+				gint64 left = state->map_size - state->raw_pos;
+
+				state->next = state->map + state->raw_pos;
+				state->have = left > MAP_CHUNK ? MAP_CHUNK : (unsigned)left;
+				state->raw_pos += state->have;
+				return 0;
+			}
+
+			/* We're past the end of the mapping, either at the
+			   end of the file or because the file has grown
+			   since we mapped it; read() whatever is there. */
+			file_map_shrunk(state);
+			if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1) {
+				state->err = errno;
+				state->err_info = NULL;
+				return -1;
+			}
+		}
+#endif
 		if (raw_read(state, state->out, state->size /* << 1 */, &(state->have)) == -1)
 			return -1;
 		state->next = state->out;
@@ -782,6 +902,11 @@ file_fdopen(int fd)
 
 	state->fast_seek_cur = NULL;
 	state->fast_seek = NULL;
+#ifdef HAVE_MMAP
+	state->map = NULL;
+	state->map_size = 0;
+	state->map_failed = FALSE;
+#endif
 
 	/* open the file with the appropriate mode (or just use fd) */
 	state->fd = fd;
@@ -896,6 +1021,212 @@ file_set_random_access(FILE_T stream, gboolean random _U_, GPtrArray *seek)
 	stream->fast_seek = seek;
 }
 
+/*
+ * Building the fast seek index for a compressed file means decompressing
+ * all of it.  If WIRESHARK_SEEK_INDEX is set in the environment, we save
+ * the index of a compressed file next to it, with the windows compressed,
+ * once we have read the file to the end, and load it back the next time
+ * the file is opened, so that seeking is fast right away.
+ *
+ * The index is a cache for this machine, so it's written in host byte
+ * order; it records the size and modification time of the capture file
+ * and is ignored if either has changed.
+ */
+#ifdef HAVE_LIBZ
+#define SEEK_INDEX_SUFFIX	".seekidx"
+#define SEEK_INDEX_MAGIC	"WTSEEKI1"
+
+struct seek_index_header {
+	char magic[8];
+	gint64 file_size;
+	gint64 file_mtime;
+	guint32 byte_order;	/* 0x01020304 as written */
+	guint32 count;		/* number of seek points */
+};
+
+struct seek_index_point {
+	gint64 out;
+	gint64 in;
+	gint32 compression;
+	gint32 bits;
+	guint32 adler;
+	guint32 total_out;
+	guint32 window_len;	/* length of the compressed window that follows */
+	guint32 pad;
+};
+
+static gboolean
+seek_index_header_init(struct seek_index_header *hdr, const char *path)
+{
+	ws_statb64 statb;
+
+	if (ws_stat64(path, &statb) == -1)
+		return FALSE;
+	memset(hdr, 0, sizeof *hdr);
+	memcpy(hdr->magic, SEEK_INDEX_MAGIC, sizeof hdr->magic);
+	hdr->file_size = statb.st_size;
+	hdr->file_mtime = statb.st_mtime;
+	hdr->byte_order = 0x01020304;
+	return TRUE;
+}
+#endif /* HAVE_LIBZ */
+
+/* Load the saved index for the file at path into seek, which must be empty.
+   Return TRUE if we did, FALSE if there's no usable index. */
+gboolean
+file_seek_index_load(GPtrArray *seek, const char *path)
+{
+#ifdef HAVE_LIBZ
+	struct seek_index_header hdr, file_hdr;
+	struct seek_index_point pt;
+	struct fast_seek_point *val;
+	unsigned char *cwin = NULL;
+	uLongf win_len;
+	gchar *idx_path;
+	FILE *fp;
+	guint32 i;
+
+	if (getenv("WIRESHARK_SEEK_INDEX") == NULL || seek->len != 0)
+		return FALSE;
+	if (!seek_index_header_init(&hdr, path))
+		return FALSE;
+
+	idx_path = g_strconcat(path, SEEK_INDEX_SUFFIX, NULL);
+	fp = ws_fopen(idx_path, "rb");
+	g_free(idx_path);
+	if (fp == NULL)
+		return FALSE;
+
+	if (fread(&file_hdr, sizeof file_hdr, 1, fp) != 1 ||
+	    memcmp(&file_hdr, &hdr, G_STRUCT_OFFSET(struct seek_index_header, count)) != 0)
+		goto fail;
+
+	cwin = (unsigned char *)g_malloc(compressBound(ZLIB_WINSIZE));
+	for (i = 0; i < file_hdr.count; i++) {
+		if (fread(&pt, sizeof pt, 1, fp) != 1)
+			goto fail;
+		if (pt.compression != ZLIB && pt.compression != GZIP_AFTER_HEADER &&
+		    pt.compression != UNCOMPRESSED)
+			goto fail;
+		val = g_new(struct fast_seek_point, 1);
+		g_ptr_array_add(seek, val);
+		val->out = pt.out;
+		val->in = pt.in;
+		val->compression = pt.compression;
+		if (pt.compression != ZLIB)
+			continue;
+#ifdef HAVE_INFLATEPRIME
+		val->data.zlib.bits = pt.bits;
+#else
+		if (pt.bits != 0)
+			goto fail;
+#endif
+		val->data.zlib.adler = pt.adler;
+		val->data.zlib.total_out = pt.total_out;
+		win_len = ZLIB_WINSIZE;
+		if (pt.window_len > compressBound(ZLIB_WINSIZE) ||
+		    fread(cwin, 1, pt.window_len, fp) != pt.window_len ||
+		    uncompress(val->data.zlib.window, &win_len, cwin, pt.window_len) != Z_OK ||
+		    win_len != ZLIB_WINSIZE)
+			goto fail;
+	}
+	g_free(cwin);
+	fclose(fp);
+	return TRUE;
+
+fail:
+	/* Don't leave a partial index behind. */
+	for (i = 0; i < seek->len; i++)
+		g_free(seek->pdata[i]);
+	g_ptr_array_set_size(seek, 0);
+	g_free(cwin);
+	fclose(fp);
+	return FALSE;
+#else
+	(void)seek;
+	(void)path;
+	return FALSE;
+#endif
+}
+
+/* Save the complete index seek for the compressed file at path. */
+void
+file_seek_index_save(GPtrArray *seek, const char *path)
+{
+#ifdef HAVE_LIBZ
+	struct seek_index_header hdr;
+	struct seek_index_point pt;
+	struct fast_seek_point *item;
+	unsigned char *cwin;
+	uLongf cwin_len;
+	gchar *idx_path;
+	FILE *fp;
+	gboolean ok = TRUE;
+	guint i;
+
+	if (getenv("WIRESHARK_SEEK_INDEX") == NULL || seek->len == 0)
+		return;
+
+	/* Not worth it for a file that isn't compressed. */
+	for (i = 0; i < seek->len; i++) {
+		item = (struct fast_seek_point *)seek->pdata[i];
+		if (item->compression != UNCOMPRESSED)
+			break;
+	}
+	if (i == seek->len)
+		return;
+
+	if (!seek_index_header_init(&hdr, path))
+		return;
+	hdr.count = seek->len;
+
+	idx_path = g_strconcat(path, SEEK_INDEX_SUFFIX, NULL);
+	fp = ws_fopen(idx_path, "wb");
+	if (fp == NULL) {
+		g_free(idx_path);
+		return;
+	}
+
+	cwin = (unsigned char *)g_malloc(compressBound(ZLIB_WINSIZE));
+	if (fwrite(&hdr, sizeof hdr, 1, fp) != 1)
+		ok = FALSE;
+	for (i = 0; ok && i < seek->len; i++) {
+		item = (struct fast_seek_point *)seek->pdata[i];
+		memset(&pt, 0, sizeof pt);
+		pt.out = item->out;
+		pt.in = item->in;
+		pt.compression = item->compression;
+		if (item->compression == ZLIB) {
+#ifdef HAVE_INFLATEPRIME
+			pt.bits = item->data.zlib.bits;
+#endif
+			pt.adler = item->data.zlib.adler;
+			pt.total_out = item->data.zlib.total_out;
+			cwin_len = compressBound(ZLIB_WINSIZE);
+			if (compress2(cwin, &cwin_len, item->data.zlib.window,
+			    ZLIB_WINSIZE, Z_BEST_SPEED) != Z_OK) {
+				ok = FALSE;
+				break;
+			}
+			pt.window_len = (guint32)cwin_len;
+		}
+		if (fwrite(&pt, sizeof pt, 1, fp) != 1 ||
+		    (pt.window_len != 0 &&
+		     fwrite(cwin, 1, pt.window_len, fp) != pt.window_len))
+			ok = FALSE;
+	}
+	g_free(cwin);
+	if (fclose(fp) == EOF)
+		ok = FALSE;
+	if (!ok)
+		ws_unlink(idx_path);
+	g_free(idx_path);
+#else
+	(void)seek;
+	(void)path;
+#endif
+}
+
 gint64
 file_seek(FILE_T file, gint64 offset, int whence, int *err)
 {
@@ -920,11 +1251,24 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 
 	if (offset < 0 && file->next) {
 		/*
-		 * This is guaranteed to fit in an unsigned int.
-		 * To squelch compiler warnings, we cast the
-		 * result.
+		 * If we're handing out data from the mapped file, everything
+		 * in the mapping before "next" is still there, but only as
+		 * much of it as keeps "have" within an unsigned int can be
+		 * handed out again; longer seeks go through the raw position
+		 * below.  Otherwise, it's what's in the output buffer, which
+		 * is guaranteed to fit in an unsigned int.
 		 */
-		unsigned had = (unsigned)(file->next - file->out);
+		gint64 had;
+
+#ifdef HAVE_MMAP
+		if (file->compression == UNCOMPRESSED && file->map != NULL &&
+		    file->next >= file->map && file->next <= file->map + file->map_size) {
+			had = (file->next - file->map) - (file->start + file->raw);
+			if (had > (gint64)(G_MAXUINT - file->have))
+				had = G_MAXUINT - file->have;
+		} else
+#endif
+			had = (unsigned)(file->next - file->out);
 		if (-offset <= had) {
 			/*
 			 * Offset is negative, so -offset is
@@ -1032,7 +1376,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
 	if (file->compression == UNCOMPRESSED && file->pos + offset >= file->raw 
 			&& (offset < 0 || offset >= file->have) /* seek only when we don't have that offset in buffer */)
 	{
-		if (ws_lseek64(file->fd, offset - file->have, SEEK_CUR) == -1) {
+		/* If the file is mapped, fill_out_buffer() only needs
+		   raw_pos, so don't bother moving the descriptor. */
+		if (!FILE_IS_MAPPED(file) &&
+		    ws_lseek64(file->fd, offset - file->have, SEEK_CUR) == -1) {
 			*err = errno;
 			return -1;
 		}
@@ -1305,6 +1652,10 @@ file_clearerr(FILE_T stream)
 void
 file_fdclose(FILE_T file)
 {
+#ifdef HAVE_MMAP
+	/* The file may be replaced before it's reopened. */
+	file_unmap(file);
+#endif
 	ws_close(file->fd);
 	file->fd = -1;
 }
@@ -1317,6 +1668,12 @@ file_fdreopen(FILE_T file, const char *path)
 	if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
 		return FALSE;
 	file->fd = fd;
+#ifdef HAVE_MMAP
+	/* We may have been reading from a mapping, which doesn't move the
+	   descriptor's offset; pick up where we left off. */
+	if (ws_lseek64(fd, file->raw_pos, SEEK_SET) == -1)
+		return FALSE;
+#endif
 	return TRUE;
 }
 
@@ -1333,6 +1690,9 @@ file_close(FILE_T file)
 		g_free(file->out);
 		g_free(file->in);
 	}
+#ifdef HAVE_MMAP
+	file_unmap(file);
+#endif
 	g_free(file->fast_seek_cur);
 	file->err = 0;
 	file->err_info = NULL;
@@ -1347,20 +1707,63 @@ file_close(FILE_T file)
 }
 
 #ifdef HAVE_LIBZ
+/*
+ * We write compressed files as a sequence of independent gzip members,
+ * each holding at most GZ_BLOCK_SIZE bytes of uncompressed data and
+ * carrying its own compressed size in a "BC" extra field, as in the BGZF
+ * format used by bgzip and samtools.  The result is still an ordinary
+ * gzip file, but a reader can find the start of every member without
+ * decompressing anything, and can start decompressing at any of them
+ * without a saved dictionary.  Since the members don't depend on each
+ * other, we compress them on a thread pool when threads are available.
+ */
+#define GZ_BLOCK_SIZE   0xff00  /* uncompressed bytes per member */
+#define GZ_BLOCK_MAX    0x10000 /* largest member, headers included */
+#define GZ_HEADER_LEN   18
+#define GZ_TRAILER_LEN  8
+#define GZ_MAX_THREADS  8
+
+static const unsigned char gz_block_header[GZ_HEADER_LEN - 2] = {
+    31, 139,                /* magic */
+    8,                      /* CM = deflate */
+    4,                      /* FLG = FEXTRA */
+    0, 0, 0, 0,             /* MTIME */
+    0,                      /* XFL */
+    255,                    /* OS = unknown */
+    6, 0,                   /* XLEN */
+    'B', 'C', 2, 0          /* BSIZE subfield; BSIZE follows */
+};
+
+/* An empty member, which BGZF readers take as the end of the file */
+static const unsigned char gz_eof_block[28] = {
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0,
+    27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+struct gz_block {
+    unsigned char *in;      /* uncompressed data */
+    unsigned in_len;
+    unsigned char *out;     /* the compressed member */
+    unsigned out_len;
+    int level;              /* compression level */
+    int strategy;           /* compression strategy */
+    int err;                /* error code */
+    gboolean done;          /* has the member been compressed? */
+};
+
 /* internal gzip file state data structure for writing */
 struct wtap_writer {
     int fd;                 /* file descriptor */
     gint64 pos;             /* current position in uncompressed data */
-    unsigned size;          /* buffer size, zero if not allocated yet */
-    unsigned want;          /* requested buffer size, default is GZBUFSIZE */
-    unsigned char *in;      /* input buffer */
-    unsigned char *out;     /* output buffer (double-sized when reading) */
-    unsigned char *next;    /* next output data to deliver or write */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
     int err;                /* error code */
-	/* zlib deflate stream */
-    z_stream strm;          /* stream structure in-place (not a pointer) */
+    struct gz_block *cur;   /* block being filled, NULL if none */
+    GQueue *pending;        /* blocks being compressed, in file order */
+    guint max_pending;      /* how many blocks we let pile up */
+    GThreadPool *pool;      /* compressing threads, NULL to do it ourselves */
+    GMutex *mtx;            /* protects "done" in the pending blocks */
+    GCond *cond;            /* signalled when a block is done */
 };
 
 GZWFILE_T
@@ -1382,18 +1785,19 @@ gzwfile_open(const char *path)
     return state;
 }
 
+static void gz_block_worker(gpointer data, gpointer user_data);
+
 GZWFILE_T
 gzwfile_fdopen(int fd)
 {
     GZWFILE_T state;
+    gint threads;
 
     /* allocate wtap_writer structure to return */
     state = (GZWFILE_T)g_try_malloc(sizeof *state);
     if (state == NULL)
         return NULL;
     state->fd = fd;
-    state->size = 0;            /* no buffers allocated yet */
-    state->want = GZBUFSIZE;    /* requested buffer size */
 
     state->level = Z_DEFAULT_COMPRESSION;
     state->strategy = Z_DEFAULT_STRATEGY;
@@ -1401,119 +1805,179 @@ gzwfile_fdopen(int fd)
     /* initialize stream */
     state->err = Z_OK;              /* clear error */
     state->pos = 0;                 /* no uncompressed data yet */
-    state->strm.avail_in = 0;       /* no input data yet */
+    state->cur = NULL;              /* no block yet */
+    state->pending = g_queue_new();
+    state->pool = NULL;
+    state->mtx = NULL;
+    state->cond = NULL;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+    threads = g_get_num_processors();
+#else
+    threads = 2;
+#endif
+    if (threads > GZ_MAX_THREADS)
+        threads = GZ_MAX_THREADS;
+    state->max_pending = 2 * threads;
+
+    /* If the program has threads, compress blocks in the background. */
+    if (threads > 1 && g_thread_supported()) {
+        state->pool = g_thread_pool_new(gz_block_worker, state, threads,
+                                        FALSE, NULL);
+        if (state->pool != NULL) {
+#if GLIB_CHECK_VERSION(2,31,0)
+            state->mtx = g_malloc(sizeof(GMutex));
+            g_mutex_init(state->mtx);
+            state->cond = g_malloc(sizeof(GCond));
+            g_cond_init(state->cond);
+#else
+            state->mtx = g_mutex_new();
+            state->cond = g_cond_new();
+#endif
+        }
+    }
 
     /* return stream */
     return state;
 }
 
-/* Initialize state for writing a gzip file.  Mark initialization by setting
-   state->size to non-zero.  Return -1, and set state->err, on failure;
-   return 0 on success. */
-static int
-gz_init(GZWFILE_T state)
+static void
+gz_block_free(struct gz_block *blk)
+{
+    g_free(blk->out);
+    g_free(blk->in);
+    g_free(blk);
+}
+
+static void
+gz_put_le32(unsigned char *p, guint32 val)
 {
+    p[0] = (unsigned char)(val);
+    p[1] = (unsigned char)(val >> 8);
+    p[2] = (unsigned char)(val >> 16);
+    p[3] = (unsigned char)(val >> 24);
+}
+
+/* Compress a block into a complete gzip member.  Sets blk->err on
+   failure.  Runs on the thread pool, so it mustn't touch the writer. */
+static void
+gz_block_compress(struct gz_block *blk)
+{
+    z_stream strm;
     int ret;
-    z_streamp strm = &(state->strm);
-
-    /* allocate input and output buffers */
-    state->in = (unsigned char *)g_try_malloc(state->want);
-    state->out = (unsigned char *)g_try_malloc(state->want);
-    if (state->in == NULL || state->out == NULL) {
-        g_free(state->out);
-        g_free(state->in);
-        state->err = ENOMEM;
-        return -1;
+    unsigned bsize;
+
+    blk->out = (unsigned char *)g_try_malloc(GZ_BLOCK_MAX);
+    if (blk->out == NULL) {
+        blk->err = ENOMEM;
+        return;
     }
 
-    /* allocate deflate memory, set up for gzip compression */
-    strm->zalloc = Z_NULL;
-    strm->zfree = Z_NULL;
-    strm->opaque = Z_NULL;
-    ret = deflateInit2(strm, state->level, Z_DEFLATED,
-                       15 + 16, 8, state->strategy);
+    /* raw deflate; we write the gzip header and trailer ourselves */
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = deflateInit2(&strm, blk->level, Z_DEFLATED, -15, 8, blk->strategy);
     if (ret != Z_OK) {
-        g_free(state->out);
-        g_free(state->in);
-        if (ret == Z_MEM_ERROR) {
-        	/* This means "not enough memory". */
-        	state->err = ENOMEM;
-        } else {
-        	/* This "shouldn't happen". */
-        	state->err = WTAP_ERR_INTERNAL;
-        }
-        return -1;
+        blk->err = (ret == Z_MEM_ERROR) ? ENOMEM : WTAP_ERR_INTERNAL;
+        return;
+    }
+    strm.next_in = blk->in;
+    strm.avail_in = blk->in_len;
+    strm.next_out = blk->out + GZ_HEADER_LEN;
+    strm.avail_out = GZ_BLOCK_MAX - GZ_HEADER_LEN - GZ_TRAILER_LEN;
+    ret = deflate(&strm, Z_FINISH);
+    (void)deflateEnd(&strm);
+    if (ret != Z_STREAM_END) {
+        /* GZ_BLOCK_SIZE leaves room for incompressible data, so this
+           "shouldn't happen". */
+        blk->err = WTAP_ERR_INTERNAL;
+        return;
     }
 
-    /* mark state as initialized */
-    state->size = state->want;
-
-    /* initialize write buffer */
-    strm->avail_out = state->size;
-    strm->next_out = state->out;
-    state->next = strm->next_out;
-    return 0;
+    bsize = GZ_HEADER_LEN + (unsigned)strm.total_out + GZ_TRAILER_LEN;
+    memcpy(blk->out, gz_block_header, sizeof gz_block_header);
+    blk->out[GZ_HEADER_LEN - 2] = (unsigned char)((bsize - 1) & 0xff);
+    blk->out[GZ_HEADER_LEN - 1] = (unsigned char)((bsize - 1) >> 8);
+    gz_put_le32(blk->out + bsize - GZ_TRAILER_LEN,
+                (guint32)crc32(crc32(0L, Z_NULL, 0), blk->in, blk->in_len));
+    gz_put_le32(blk->out + bsize - 4, blk->in_len);
+    blk->out_len = bsize;
 }
 
-/* Compress whatever is at avail_in and next_in and write to the output file.
-   Return -1, and set state->err, if there is an error writing to the output
-   file; return 0 on success.
-   flush is assumed to be a valid deflate() flush value.  If flush is Z_FINISH,
-   then the deflate() state is reset to start a new gzip stream. */
-static int
-gz_comp(GZWFILE_T state, int flush)
+static void
+gz_block_worker(gpointer data, gpointer user_data)
 {
-    int ret, got;
-    unsigned have;
-    z_streamp strm = &(state->strm);
+    struct gz_block *blk = (struct gz_block *)data;
+    GZWFILE_T state = (GZWFILE_T)user_data;
 
-    /* allocate memory if this is the first time through */
-    if (state->size == 0 && gz_init(state) == -1)
-        return -1;
+    gz_block_compress(blk);
 
-    /* run deflate() on provided input until it produces no more output */
-    ret = Z_OK;
-    do {
-        /* write out current buffer contents if full, or if flushing, but if
-           doing Z_FINISH then don't write until we get to Z_STREAM_END */
-        if (strm->avail_out == 0 || (flush != Z_NO_FLUSH &&
-            (flush != Z_FINISH || ret == Z_STREAM_END))) {
-            have = (unsigned)(strm->next_out - state->next);
-            if (have) {
-		got = write(state->fd, state->next, have);
-		if (got < 0) {
-                    state->err = errno;
-                    return -1;
-                }
-                if ((unsigned)got != have) {
-                    state->err = WTAP_ERR_SHORT_WRITE;
-                    return -1;
-                }
-            }
-            if (strm->avail_out == 0) {
-                strm->avail_out = state->size;
-                strm->next_out = state->out;
-            }
-            state->next = strm->next_out;
-        }
+    g_mutex_lock(state->mtx);
+    blk->done = TRUE;
+    g_cond_broadcast(state->cond);
+    g_mutex_unlock(state->mtx);
+}
 
-        /* compress */
-        have = strm->avail_out;
-        ret = deflate(strm, flush);
-        if (ret == Z_STREAM_ERROR) {
-            /* This "shouldn't happen". */
-            state->err = WTAP_ERR_INTERNAL;
-            return -1;
+/* Write out compressed blocks, in order, as long as the oldest one is done.
+   If wait is TRUE, wait for all of them; otherwise only wait if more than
+   max_pending blocks are outstanding.  Return -1, and set state->err, on
+   failure; return 0 on success. */
+static int
+gz_write_blocks(GZWFILE_T state, gboolean wait)
+{
+    struct gz_block *blk;
+    gboolean done;
+    ssize_t got;
+
+    while ((blk = (struct gz_block *)g_queue_peek_head(state->pending)) != NULL) {
+        if (state->pool != NULL) {
+            /* Only look at done with the lock held; once it's set, the
+               worker is finished with the block. */
+            g_mutex_lock(state->mtx);
+            while (!blk->done &&
+                   (wait || g_queue_get_length(state->pending) > state->max_pending))
+                g_cond_wait(state->cond, state->mtx);
+            done = blk->done;
+            g_mutex_unlock(state->mtx);
+            if (!done)
+                break;
+        }
+        g_queue_pop_head(state->pending);
+
+        if (blk->err != 0) {
+            if (state->err == Z_OK)
+                state->err = blk->err;
+        } else if (state->err == Z_OK) {
+            got = write(state->fd, blk->out, blk->out_len);
+            if (got < 0)
+                state->err = errno;
+            else if ((unsigned)got != blk->out_len)
+                state->err = WTAP_ERR_SHORT_WRITE;
         }
-        have -= strm->avail_out;
-    } while (have);
+        gz_block_free(blk);
+    }
+    return state->err == Z_OK ? 0 : -1;
+}
+
+/* Hand the current block, if any, over to be compressed.  Return -1, and
+   set state->err, on failure; return 0 on success. */
+static int
+gz_comp(GZWFILE_T state)
+{
+    struct gz_block *blk = state->cur;
+
+    if (blk == NULL || blk->in_len == 0)
+        return 0;
+    state->cur = NULL;
 
-    /* if that completed a deflate stream, allow another to start */
-    if (flush == Z_FINISH)
-        deflateReset(strm);
+    g_queue_push_tail(state->pending, blk);
+    if (state->pool != NULL)
+        g_thread_pool_push(state->pool, blk, NULL);
+    else
+        gz_block_compress(blk);
 
-    /* all done, no errors */
-    return 0;
+    return gz_write_blocks(state, FALSE);
 }
 
 /* Write out len bytes from buf.  Return 0, and set state->err, on
@@ -1524,9 +1988,7 @@ gzwfile_write(GZWFILE_T state, const void *buf, unsigned len)
 {
     unsigned put = len;
     unsigned n;
-    z_streamp strm;
-
-    strm = &(state->strm);
+    struct gz_block *blk;
 
     /* check that there's no error */
     if (state->err != Z_OK)
@@ -1536,40 +1998,42 @@ gzwfile_write(GZWFILE_T state, const void *buf, unsigned len)
     if (len == 0)
         return 0;
 
-    /* allocate memory if this is the first time through */
-    if (state->size == 0 && gz_init(state) == -1)
-        return 0;
-
-    /* for small len, copy to input buffer, otherwise compress directly */
-    if (len < state->size) {
-        /* copy to input buffer, compress when full */
-        do {
-            if (strm->avail_in == 0)
-                strm->next_in = state->in;
-            n = state->size - strm->avail_in;
-            if (n > len)
-                n = len;
-            memcpy(strm->next_in + strm->avail_in, buf, n);
-            strm->avail_in += n;
-            state->pos += n;
-            buf = (char *)buf + n;
-            len -= n;
-            if (len && gz_comp(state, Z_NO_FLUSH) == -1)
+    /* copy to the current block, compress when full */
+    do {
+        if (state->cur == NULL) {
+            blk = (struct gz_block *)g_try_malloc(sizeof *blk);
+            if (blk != NULL) {
+                blk->in = (unsigned char *)g_try_malloc(GZ_BLOCK_SIZE);
+                if (blk->in == NULL) {
+                    g_free(blk);
+                    blk = NULL;
+                }
+            }
+            if (blk == NULL) {
+                state->err = ENOMEM;
                 return 0;
-        } while (len);
-    }
-    else {
-        /* consume whatever's left in the input buffer */
-        if (strm->avail_in && gz_comp(state, Z_NO_FLUSH) == -1)
-            return 0;
-
-        /* directly compress user buffer to file */
-        strm->avail_in = len;
-        strm->next_in = (voidp)buf;
-        state->pos += len;
-        if (gz_comp(state, Z_NO_FLUSH) == -1)
+            }
+            blk->in_len = 0;
+            blk->out = NULL;
+            blk->out_len = 0;
+            blk->level = state->level;
+            blk->strategy = state->strategy;
+            blk->err = 0;
+            blk->done = FALSE;
+            state->cur = blk;
+        }
+        blk = state->cur;
+        n = GZ_BLOCK_SIZE - blk->in_len;
+        if (n > len)
+            n = len;
+        memcpy(blk->in + blk->in_len, buf, n);
+        blk->in_len += n;
+        state->pos += n;
+        buf = (const char *)buf + n;
+        len -= n;
+        if (blk->in_len == GZ_BLOCK_SIZE && gz_comp(state) == -1)
             return 0;
-    }
+    } while (len);
 
     /* input was all buffered or compressed (put will fit in int) */
     return (int)put;
@@ -1584,9 +2048,8 @@ gzwfile_flush(GZWFILE_T state)
     if (state->err != Z_OK)
         return -1;
 
-    /* compress remaining data with Z_SYNC_FLUSH */
-    gz_comp(state, Z_SYNC_FLUSH);
-    if (state->err != Z_OK)
+    /* end the current member and wait for everything to be written */
+    if (gz_comp(state) == -1 || gz_write_blocks(state, TRUE) == -1)
         return -1;
     return 0;
 }
@@ -1597,13 +2060,34 @@ int
 gzwfile_close(GZWFILE_T state)
 {
     int ret = 0;
+    ssize_t got;
 
     /* flush, free memory, and close file */
-    if (gz_comp(state, Z_FINISH) == -1 && ret == 0)
-        ret = state->err;
-    (void)deflateEnd(&(state->strm));
-    g_free(state->out);
-    g_free(state->in);
+    gz_comp(state);
+    gz_write_blocks(state, TRUE);
+    if (state->err == Z_OK) {
+        got = write(state->fd, gz_eof_block, sizeof gz_eof_block);
+        if (got < 0)
+            state->err = errno;
+        else if ((unsigned)got != sizeof gz_eof_block)
+            state->err = WTAP_ERR_SHORT_WRITE;
+    }
+    ret = state->err;
+    if (state->cur != NULL)
+        gz_block_free(state->cur);
+    if (state->pool != NULL) {
+        g_thread_pool_free(state->pool, FALSE, TRUE);
+#if GLIB_CHECK_VERSION(2,31,0)
+        g_cond_clear(state->cond);
+        g_free(state->cond);
+        g_mutex_clear(state->mtx);
+        g_free(state->mtx);
+#else
+        g_cond_free(state->cond);
+        g_mutex_free(state->mtx);
+#endif
+    }
+    g_queue_free(state->pending);
     state->err = Z_OK;
     if (close(state->fd) == -1 && ret == 0)
         ret = errno;
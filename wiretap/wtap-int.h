@@ -76,6 +76,8 @@ struct wtap {
     wtap_new_ipv4_callback_t    add_new_ipv4;
     wtap_new_ipv6_callback_t    add_new_ipv6;
     GPtrArray                   *fast_seek;
+    gboolean                    fast_seek_complete;     /**< TRUE once fast_seek covers the whole file */
+    gchar                       *fast_seek_save_path;   /**< file whose fast_seek index to save at close, or NULL */
 };
 
 struct wtap_dumper;
@@ -782,6 +782,11 @@ wtap_close(wtap *wth)
 	if (wth->priv != NULL)
 		g_free(wth->priv);
 
+	if (wth->fast_seek_save_path != NULL) {
+		if (wth->fast_seek_complete)
+			file_seek_index_save(wth->fast_seek, wth->fast_seek_save_path);
+		g_free(wth->fast_seek_save_path);
+	}
 	if (wth->fast_seek != NULL) {
 		g_ptr_array_foreach(wth->fast_seek, g_fast_seek_item_free, NULL);
 		g_ptr_array_free(wth->fast_seek, TRUE);
@@ -863,6 +868,9 @@ wtap_read(wtap *wth, int *err, gchar **err_info, gint64 *data_offset)
 		 */
 		if (*err == 0)
 			*err = file_error(wth->fh, err_info);
+		/* Having read everything, we have seek points for all of it. */
+		if (*err == 0)
+			wth->fast_seek_complete = TRUE;
 		return FALSE;	/* failure */
 	}
 